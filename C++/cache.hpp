@@ -11,6 +11,7 @@
 #ifndef CACHE_H
 #define CACHE_H
 
+#include <cstddef>
 #include <cstdint>
 
 // Default configuration -- Don't modify
@@ -85,9 +86,33 @@ struct cache_stats_t {
 
 };
 
+// Struct for reporting how much of the configured caches a run touched
+struct cache_footprint_t {
+    uint64_t sets_l1;                       // sets in the L1
+    uint64_t sets_materialized_l1;          // L1 sets that ever held a block
+    uint64_t sets_l2;                       // sets in the L2
+    uint64_t sets_materialized_l2;          // L2 sets that ever held a block
+};
+
 // Visible functions
 void cache_init(struct cache_config_t *conf);
 void cache_access(uint64_t addr, char rw, struct cache_stats_t *stats);
+void cache_access_batch(const uint64_t *addrs, const uint8_t *rw, size_t n,
+                        struct cache_stats_t *stats);
+void cache_access_runs(const uint64_t *addrs, const uint8_t *rw,
+                       const uint32_t *repeat_reads, const uint32_t *repeat_writes,
+                       size_t n, struct cache_stats_t *stats);
+void cache_footprint(struct cache_footprint_t *footprint);
 void cache_cleanup(struct cache_stats_t *stats);
 
+// Several configurations simulated together; arrays hold one element per
+// configuration given to cache_init_lockstep()
+void cache_init_lockstep(const struct cache_config_t *confs, size_t num_confs);
+void cache_access_runs_lockstep(const uint64_t *addrs, const uint8_t *rw,
+                                const uint32_t *repeat_reads,
+                                const uint32_t *repeat_writes, size_t n,
+                                struct cache_stats_t *stats);
+void cache_footprint_lockstep(struct cache_footprint_t *footprints);
+void cache_cleanup_lockstep(struct cache_stats_t *stats);
+
 #endif // CACHE_H
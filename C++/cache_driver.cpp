@@ -9,22 +9,30 @@
  */
 
 #include <getopt.h>
+#include <algorithm>
+#include <atomic>
 #include <cinttypes>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 // #include <unistd.h>
 
 #include "cache.hpp"
+#include "stack_distance.hpp"
+#include "trace.hpp"
 
 static void print_err_usage(std::string err)
 {
     std::cout << err << std::endl;
     // print usage
-    std::cout << "./cachesim [OPTIONS] -i <tracename.trace>" << std::endl;
+    std::cout << "./cachesim [OPTIONS] -i <tracename.trace|tracename.btrace>" << std::endl;
     std::cout << "    -c c     Total size of the L1 cache is 2^c bytes" << std::endl;
     std::cout << "    -s s     Number of blocks per set in the L1 cache is 2^s" << std::endl;
     std::cout << "    -b b     Block size in both cases is 2^b bytes" << std::endl;
@@ -32,9 +40,29 @@ static void print_err_usage(std::string err)
     std::cout << "    -S S     Number of blocks per set in the L2 cache is 2^S" << std::endl;
     std::cout << "    -v v     Number of blocks in the victim cache is v" << std::endl;
     std::cout << "    -k k     Prefetch distance is k" << std::endl;
+    std::cout << "    --start X  Skip the first X accesses of the trace" << std::endl;
+    std::cout << "    --count N  Simulate at most N accesses" << std::endl;
+    std::cout << "    --scenario \"OPTS\"  Also run with OPTS (e.g. \"-v 0 -k 0\") applied" << std::endl;
+    std::cout << "               on top of the other options; may be repeated" << std::endl;
+    std::cout << "    --footprint  Also print how many cache sets each run used" << std::endl;
+    std::cout << "    --mattson N  Instead print L1 miss rates for s = 0..N at the number" << std::endl;
+    std::cout << "               of L1 sets given by -c, -s and -b, in one pass per trace" << std::endl;
+    std::cout << "    --all-assoc \"c=LO..HI s=LO..HI\"  Instead print L1 misses for every" << std::endl;
+    std::cout << "               (c, s) in the ranges at the -b block size, in one pass per trace" << std::endl;
+    std::cout << "    --sweep c=LO..HI s=... C=... S=... b=... v=0,4,8 k=...  Instead run" << std::endl;
+    std::cout << "               every combination of the given values and print one CSV" << std::endl;
+    std::cout << "               row per trace and configuration" << std::endl;
+    std::cout << "    -j N     Run a sweep on N worker threads (default: one per core)" << std::endl;
+    std::cout << "-i may be repeated. With several traces or scenarios each trace is" << std::endl;
+    std::cout << "loaded once and every scenario is run against every trace." << std::endl;
     std::exit(EXIT_FAILURE);
 }
 
+static const char *trace_name(const char *path)
+{
+    return path ? path : "stdin";
+}
+
 static void print_config(struct cache_config_t *conf)
 {
     std::cout << "Cache Configuration" << std::endl;
@@ -77,10 +105,712 @@ static void print_stats(struct cache_stats_t *stats)
     std::cout << "Average Access Time:            " << std::setprecision(6) << stats->avg_access_time << std::endl;
 }
 
+static void print_footprint(struct cache_footprint_t *footprint)
+{
+    std::cout << std::endl << "FOOTPRINT" << std::endl;
+    std::cout << "L1 sets materialized:           " << footprint->sets_materialized_l1
+              << " of " << footprint->sets_l1 << std::endl;
+    std::cout << "L2 sets materialized:           " << footprint->sets_materialized_l2
+              << " of " << footprint->sets_l2 << std::endl;
+}
+
+static void print_grid(const AllAssocProfile& profile,
+        const std::vector<uint64_t>& cs, const std::vector<uint64_t>& ss,
+        bool rates)
+{
+    std::cout << (rates ? "L1 miss rate" : "L1 misses") << std::endl;
+    std::cout << " c \\ s";
+    for (size_t j = 0; j < ss.size(); ++j) {
+        std::cout << std::setw(12) << ss[j];
+    }
+    std::cout << std::endl;
+    for (size_t i = 0; i < cs.size(); ++i) {
+        std::cout << std::setw(6) << cs[i];
+        for (size_t j = 0; j < ss.size(); ++j) {
+            if (!profile.covers(cs[i], ss[j])) {
+                std::cout << std::setw(12) << "-";
+            } else if (!rates) {
+                std::cout << std::setw(12) << profile.getMisses(cs[i], ss[j]);
+            } else {
+                double rate = profile.getAccesses()
+                    ? (double) profile.getMisses(cs[i], ss[j])
+                        / (double) profile.getAccesses() : 0.0;
+                std::cout << std::setw(12) << std::setprecision(6) << rate;
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+static void print_all_assoc(const AllAssocProfile& profile,
+        const std::vector<uint64_t>& cs, const std::vector<uint64_t>& ss,
+        uint64_t b)
+{
+    std::cout << std::fixed;
+    std::cout << std::endl << "L1 MISSES BY SIZE AND ASSOCIATIVITY" << std::endl;
+    std::cout << "Block size: 2^" << b << " bytes" << std::endl;
+    std::cout << "Total Number of accesses:       " << profile.getAccesses() << std::endl;
+    print_grid(profile, cs, ss, false);
+    print_grid(profile, cs, ss, true);
+}
+
+static void print_stack_profile(const StackProfile& profile,
+        uint64_t index_bits, uint64_t b)
+{
+    std::cout << std::fixed;
+    std::cout << std::endl << "L1 MISS RATES BY ASSOCIATIVITY" << std::endl;
+    std::cout << "Sets: 2^" << index_bits << ", block size: 2^" << b << " bytes" << std::endl;
+    std::cout << "Total Number of accesses:       " << profile.getAccesses() << std::endl;
+    std::cout << "   s    c        L1 misses    L1 miss rate" << std::endl;
+    for (uint64_t s = 0; s <= profile.getMaxS(); ++s) {
+        uint64_t misses = profile.getMisses(s);
+        double rate = profile.getAccesses()
+            ? (double) misses / (double) profile.getAccesses() : 0.0;
+        std::cout << std::setw(4) << s << std::setw(5) << index_bits + s + b
+                  << std::setw(17) << misses
+                  << std::setw(16) << std::setprecision(6) << rate << std::endl;
+    }
+}
+
+// Long-only options
+static const int OPT_START = 256;
+static const int OPT_COUNT = 257;
+static const int OPT_SCENARIO = 258;
+static const int OPT_FOOTPRINT = 259;
+static const int OPT_MATTSON = 260;
+static const int OPT_ALL_ASSOC = 261;
+static const int OPT_SWEEP = 262;
+
+static const struct option LONG_OPTIONS[] = {
+    {"start", required_argument, NULL, OPT_START},
+    {"count", required_argument, NULL, OPT_COUNT},
+    {"scenario", required_argument, NULL, OPT_SCENARIO},
+    {"footprint", no_argument, NULL, OPT_FOOTPRINT},
+    {"mattson", required_argument, NULL, OPT_MATTSON},
+    {"all-assoc", required_argument, NULL, OPT_ALL_ASSOC},
+    {"sweep", required_argument, NULL, OPT_SWEEP},
+    {NULL, 0, NULL, 0}
+};
+
+/**
+ * @brief Apply one cache configuration option
+ * @return false if opt is not a configuration option
+ */
+static bool set_config_option(struct cache_config_t *conf, int opt,
+        const char *arg)
+{
+    switch (opt) {
+        case 'c':
+            conf->c = (uint64_t) atoi(arg);
+            return true;
+        case 'C':
+            conf->C = (uint64_t) atoi(arg);
+            return true;
+        case 'b':
+        case 'B': // Just incase someone decides to pass 'B' for the block size
+            conf->b = (uint64_t) atoi(arg);
+            return true;
+        case 's':
+            conf->s = (uint64_t) atoi(arg);
+            return true;
+        case 'S':
+            conf->S = (uint64_t) atoi(arg);
+            return true;
+        case 'v':
+        case 'V':
+            conf->v = (uint64_t) atoi(arg);
+            return true;
+        case 'k':
+        case 'K':
+            conf->k = (uint64_t) atoi(arg);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Build a scenario's configuration from "-v 0 -k 0" style options
+ */
+static struct cache_config_t parse_scenario(const std::string& spec,
+        const struct cache_config_t& base)
+{
+    struct cache_config_t conf = base;
+    std::istringstream in(spec);
+    std::string flag, value;
+    while (in >> flag) {
+        if (flag.size() < 2 || flag[0] != '-') {
+            print_err_usage("Bad scenario: " + spec);
+        }
+        if (flag.size() > 2) {
+            value = flag.substr(2);
+        } else if (!(in >> value)) {
+            print_err_usage("Bad scenario: " + spec);
+        }
+        if (!set_config_option(&conf, flag[1], value.c_str())) {
+            print_err_usage("Bad scenario: " + spec);
+        }
+    }
+    return conf;
+}
+
+/**
+ * Largest value a range may give c, C, s, S or b, which are log2 sizes
+ */
+static const uint64_t MAX_LOG2_VALUE = 63;
+
+/**
+ * Largest value a range may give v or k
+ */
+static const uint64_t MAX_COUNT_VALUE = 1024;
+
+/**
+ * @brief Parse one end of a range, which must be a plain decimal number no
+ * larger than max
+ */
+static uint64_t parse_bound(const std::string& text, uint64_t max,
+        const std::string& spec)
+{
+    // Digits only: strtoull would take a sign and wrap negative numbers
+    if (text.empty() || text.size() > 4
+            || text.find_first_not_of("0123456789") != std::string::npos) {
+        print_err_usage("Bad value list: " + spec);
+    }
+    uint64_t value = strtoull(text.c_str(), NULL, 10);
+    if (value > max) {
+        print_err_usage("Bad value list: " + spec + " (values go up to "
+                + std::to_string(max) + ")");
+    }
+    return value;
+}
+
+/**
+ * @brief Parse "12..16", "0,4,8" or a mix such as "0..2,8" into values of
+ * at most max
+ */
+static std::vector<uint64_t> parse_values(const std::string& spec,
+        uint64_t max)
+{
+    std::vector<uint64_t> values;
+    std::istringstream in(spec);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        size_t dots = item.find("..");
+        uint64_t lo = parse_bound(item.substr(0, dots), max, spec);
+        uint64_t hi = lo;
+        if (dots != std::string::npos) {
+            hi = parse_bound(item.substr(dots + 2), max, spec);
+        }
+        if (hi < lo) {
+            print_err_usage("Bad value list: " + spec);
+        }
+        for (uint64_t v = lo; v <= hi; ++v) {
+            values.push_back(v);
+        }
+    }
+    if (values.empty()) {
+        print_err_usage("Bad value list: " + spec);
+    }
+    return values;
+}
+
+/**
+ * @brief Parse "c=12..16 s=0..4" style ranges of configuration options
+ *
+ * ranges[opt] is left alone for options not in spec; only the options in
+ * allowed may appear.
+ */
+static void parse_ranges(const std::string& spec, const std::string& allowed,
+        std::vector<uint64_t> ranges[128])
+{
+    std::istringstream in(spec);
+    std::string item;
+    while (in >> item) {
+        if (item.size() < 3 || item[1] != '='
+                || allowed.find(item[0]) == std::string::npos) {
+            print_err_usage("Bad range: " + item);
+        }
+        bool count = item[0] == 'v' || item[0] == 'k';
+        ranges[(unsigned char) item[0]] = parse_values(item.substr(2),
+                count ? MAX_COUNT_VALUE : MAX_LOG2_VALUE);
+    }
+}
+
+/**
+ * @brief The configuration field set by an option letter
+ */
+static uint64_t *config_field(struct cache_config_t *conf, char opt)
+{
+    switch (opt) {
+        case 'c': return &conf->c;
+        case 'C': return &conf->C;
+        case 'b': return &conf->b;
+        case 's': return &conf->s;
+        case 'S': return &conf->S;
+        case 'v': return &conf->v;
+        default: return &conf->k;
+    }
+}
+
+/**
+ * @brief Every configuration of a sweep spec, in a fixed order
+ *
+ * Options vary like the digits of a number, c slowest and k fastest, and
+ * options missing from spec keep their value in base. Configurations whose
+ * sets would need more blocks than fit in the cache are left out.
+ */
+static std::vector<struct cache_config_t> expand_sweep(const std::string& spec,
+        const struct cache_config_t& base)
+{
+    static const char SWEEP_OPTIONS[] = "csbCSvk";
+    static const size_t NUM_OPTIONS = sizeof(SWEEP_OPTIONS) - 1;
+
+    std::vector<uint64_t> ranges[128];
+    struct cache_config_t conf = base;
+    for (size_t o = 0; o < NUM_OPTIONS; ++o) {
+        ranges[(unsigned char) SWEEP_OPTIONS[o]].push_back(
+                *config_field(&conf, SWEEP_OPTIONS[o]));
+    }
+    parse_ranges(spec, SWEEP_OPTIONS, ranges);
+
+    std::vector<struct cache_config_t> confs;
+    std::vector<size_t> at(NUM_OPTIONS, 0);
+    for (;;) {
+        for (size_t o = 0; o < NUM_OPTIONS; ++o) {
+            *config_field(&conf, SWEEP_OPTIONS[o])
+                = ranges[(unsigned char) SWEEP_OPTIONS[o]][at[o]];
+        }
+        if (conf.c >= conf.s + conf.b && conf.C >= conf.S + conf.b) {
+            confs.push_back(conf);
+        }
+
+        size_t o = NUM_OPTIONS;
+        while (o > 0) {
+            --o;
+            if (++at[o] < ranges[(unsigned char) SWEEP_OPTIONS[o]].size()) {
+                break;
+            }
+            at[o] = 0;
+        }
+        if (o == 0 && at[0] == 0) {
+            return confs;
+        }
+    }
+}
+
+static void print_csv_header()
+{
+    std::cout << "trace,c,s,b,C,S,v,k,"
+              << "num_accesses,num_accesses_writes,num_accesses_reads,"
+              << "num_misses_l1,num_misses_reads_l1,num_misses_writes_l1,"
+              << "num_hits_vc,num_misses_vc,num_misses_reads_vc,num_misses_writes_vc,"
+              << "num_misses_l2,num_misses_reads_l2,num_misses_writes_l2,"
+              << "num_write_backs,num_bytes_transferred,"
+              << "num_prefetches,num_useful_prefetches,"
+              << "hit_time_l1,hit_time_l2,hit_time_mem,"
+              << "miss_rate_l1,miss_rate_vc,miss_rate_l2,avg_access_time"
+              << std::endl;
+}
+
+static void print_csv_row(const char *trace, const struct cache_config_t& conf,
+        const struct cache_stats_t& stats)
+{
+    std::cout << std::fixed << std::setprecision(6)
+              << trace_name(trace) << ','
+              << conf.c << ',' << conf.s << ',' << conf.b << ','
+              << conf.C << ',' << conf.S << ',' << conf.v << ',' << conf.k << ','
+              << stats.num_accesses << ',' << stats.num_accesses_writes << ','
+              << stats.num_accesses_reads << ','
+              << stats.num_misses_l1 << ',' << stats.num_misses_reads_l1 << ','
+              << stats.num_misses_writes_l1 << ','
+              << stats.num_hits_vc << ',' << stats.num_misses_vc << ','
+              << stats.num_misses_reads_vc << ',' << stats.num_misses_writes_vc << ','
+              << stats.num_misses_l2 << ',' << stats.num_misses_reads_l2 << ','
+              << stats.num_misses_writes_l2 << ','
+              << stats.num_write_backs << ',' << stats.num_bytes_transferred << ','
+              << stats.num_prefetches << ',' << stats.num_useful_prefetches << ','
+              << stats.hit_time_l1 << ',' << stats.hit_time_l2 << ','
+              << stats.hit_time_mem << ','
+              << stats.miss_rate_l1 << ',' << stats.miss_rate_vc << ','
+              << stats.miss_rate_l2 << ',' << stats.avg_access_time
+              << std::endl;
+}
+
+/**
+ * Configurations a sweep worker simulates in lockstep over one pass of a
+ * trace
+ */
+static const size_t SWEEP_GROUP = 8;
+
+/**
+ * @brief Work shared by the threads of a sweep
+ *
+ * Work item i is group i % groups of the configurations, on trace
+ * i / groups. Results of configuration j on trace t go to
+ * stats[t * confs.size() + j], so the output order does not depend on
+ * which worker ran what.
+ */
+struct sweep_t {
+    const std::vector<TraceBuffer> *buffers;
+    const std::vector<struct cache_config_t> *confs;
+    std::vector<struct cache_stats_t> *stats;
+    size_t groups;
+    std::atomic<size_t> next;
+};
+
+static void run_sweep_worker(sweep_t *sweep)
+{
+    // Engines are created on this thread so their memory is local to it
+    LockstepEngine engine;
+    std::unique_ptr<trace_batch_t> batch(new trace_batch_t);
+    const std::vector<struct cache_config_t>& confs = *sweep->confs;
+
+    size_t item;
+    while ((item = sweep->next++) < sweep->buffers->size() * sweep->groups) {
+        size_t t = item / sweep->groups;
+        size_t first = (item % sweep->groups) * SWEEP_GROUP;
+        size_t n = std::min(SWEEP_GROUP, confs.size() - first);
+        uint64_t min_b = UINT64_MAX;
+        for (size_t i = first; i < first + n; ++i) {
+            min_b = std::min(min_b, confs[i].b);
+        }
+
+        engine.init(&confs[first], n);
+        struct cache_stats_t *stats = &(*sweep->stats)[t * confs.size() + first];
+        size_t cursor = 0;
+        while ((*sweep->buffers)[t].fillRuns(&cursor, min_b, batch.get())) {
+            engine.accessRuns(batch->addr, batch->write, batch->repeat_reads,
+                    batch->repeat_writes, batch->n, stats);
+        }
+    }
+}
+
+/**
+ * @brief Zero the stats and set the access times for a configuration
+ */
+static void init_stats(struct cache_stats_t *stats,
+        const struct cache_config_t& conf)
+{
+    memset(stats, 0, sizeof(struct cache_stats_t));
+
+    // Set access times for each level of the memory hierarchy
+    stats->hit_time_l1 = HIT_TIME_L1_BASE + ADJUSTMENT_FACTOR_L1 * (double) conf.s;
+    stats->hit_time_l2 = HIT_TIME_L2_BASE + ADJUSTMENT_FACTOR_L2 * (double) conf.S;
+    stats->hit_time_mem = HIT_TIME_MEM;
+}
+
+/**
+ * @brief The --start/--count window simulated out of every trace
+ */
+struct window_t {
+    uint64_t start;
+    uint64_t count;
+};
+
+/**
+ * @brief Open a trace positioned at the start of the window
+ *
+ * Exits with an error message if the trace ends before the window starts,
+ * or if it is a binary trace and min_b, the smallest block size it will be
+ * simulated with, is 0: binary records keep the R/W flag in address bit 0,
+ * which is then part of the block address.
+ */
+static std::unique_ptr<TraceReader> open_window(const char *path,
+        const window_t& window, uint64_t min_b)
+{
+    std::unique_ptr<TraceReader> reader(new TraceReader(path));
+    if (reader->isBinary() && min_b == 0) {
+        std::cout << trace_name(path) << ": binary traces need b >= 1"
+                  << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (!reader->seek(window.start)) {
+        std::cout << trace_name(path) << ": --start " << window.start
+                  << " is past the end of the trace" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    reader->limit(window.count);
+    return reader;
+}
+
+/**
+ * @brief Feed the window of a trace through a StackProfile or
+ * AllAssocProfile
+ */
+template <class Profile>
+static void profile_trace(Profile& profile, const char *path,
+        const window_t& window, uint64_t b)
+{
+    std::unique_ptr<TraceReader> reader = open_window(path, window, b);
+    TracePipeline pipeline(*reader, b);
+
+    const trace_batch_t *batch;
+    while ((batch = pipeline.acquire()) != NULL) {
+        profile.accessRuns(batch->addr, batch->repeat_reads,
+                batch->repeat_writes, batch->n);
+        pipeline.release();
+    }
+}
+
+/**
+ * @brief Run every configuration of a sweep spec on a pool of num_threads
+ * workers and print one CSV row per trace and configuration
+ */
+static int run_sweep(const std::string& spec,
+        const struct cache_config_t& base,
+        const std::vector<const char *>& trace_paths, const window_t& window,
+        size_t num_threads)
+{
+    std::vector<struct cache_config_t> confs = expand_sweep(spec, base);
+    uint64_t min_b = UINT64_MAX;
+    for (size_t i = 0; i < confs.size(); ++i) {
+        min_b = std::min(min_b, confs[i].b);
+    }
+
+    // One read-only copy of each trace, shared by all workers
+    std::vector<TraceBuffer> buffers;
+    buffers.reserve(trace_paths.size());
+    for (size_t t = 0; t < trace_paths.size(); ++t) {
+        buffers.emplace_back(*open_window(trace_paths[t], window, min_b));
+    }
+
+    std::vector<struct cache_stats_t> all_stats(
+            trace_paths.size() * confs.size());
+    for (size_t i = 0; i < all_stats.size(); ++i) {
+        init_stats(&all_stats[i], confs[i % confs.size()]);
+    }
+
+    sweep_t work;
+    work.buffers = &buffers;
+    work.confs = &confs;
+    work.stats = &all_stats;
+    work.groups = (confs.size() + SWEEP_GROUP - 1) / SWEEP_GROUP;
+    work.next = 0;
+
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < std::max(num_threads, (size_t) 1); ++w) {
+        workers.emplace_back(run_sweep_worker, &work);
+    }
+    for (size_t w = 0; w < workers.size(); ++w) {
+        workers[w].join();
+    }
+
+    print_csv_header();
+    for (size_t i = 0; i < all_stats.size(); ++i) {
+        cache_cleanup(&all_stats[i]);
+        print_csv_row(trace_paths[i / confs.size()], confs[i % confs.size()],
+                all_stats[i]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Print the L1 miss rate of every s up to max_s at the number of L1
+ * sets of conf
+ */
+static int run_mattson(const struct cache_config_t& conf, uint64_t max_s,
+        const std::vector<const char *>& trace_paths, const window_t& window)
+{
+    // The L1 geometry only fixes the number of sets; every s up to the
+    // given one comes out of the same pass
+    if (conf.c < conf.s + conf.b) {
+        print_err_usage("L1 needs c >= s + b");
+    }
+    if (max_s > STACK_PROFILE_MAX_S) {
+        print_err_usage("--mattson supports s up to "
+                + std::to_string(STACK_PROFILE_MAX_S));
+    }
+    uint64_t index_bits = conf.c - conf.s - conf.b;
+
+    StackProfile profile;
+    for (size_t t = 0; t < trace_paths.size(); ++t) {
+        if (trace_paths.size() > 1) {
+            std::cout << std::endl << "--- " << trace_name(trace_paths[t])
+                      << " ---" << std::endl;
+        }
+        profile.init(index_bits, conf.b, max_s);
+        profile_trace(profile, trace_paths[t], window, conf.b);
+        print_stack_profile(profile, index_bits, conf.b);
+    }
+    return 0;
+}
+
+/**
+ * @brief Print the L1 misses of every (c, s) in the ranges of spec
+ */
+static int run_all_assoc(const char *spec, const struct cache_config_t& conf,
+        const std::vector<const char *>& trace_paths, const window_t& window)
+{
+    std::vector<uint64_t> ranges[128];
+    ranges['c'].push_back(conf.c);
+    ranges['s'].push_back(conf.s);
+    parse_ranges(spec, "cs", ranges);
+    const std::vector<uint64_t>& cs = ranges['c'];
+    const std::vector<uint64_t>& ss = ranges['s'];
+    uint64_t max_s = *std::max_element(ss.begin(), ss.end());
+    if (max_s > STACK_PROFILE_MAX_S) {
+        print_err_usage("--all-assoc supports s up to "
+                + std::to_string(STACK_PROFILE_MAX_S));
+    }
+
+    AllAssocProfile profile;
+    for (size_t t = 0; t < trace_paths.size(); ++t) {
+        if (trace_paths.size() > 1) {
+            std::cout << std::endl << "--- " << trace_name(trace_paths[t])
+                      << " ---" << std::endl;
+        }
+        profile.init(conf.b, *std::min_element(cs.begin(), cs.end()),
+                *std::max_element(cs.begin(), cs.end()), max_s);
+        profile_trace(profile, trace_paths[t], window, conf.b);
+        print_all_assoc(profile, cs, ss, conf.b);
+    }
+    return 0;
+}
+
+/**
+ * @brief Exit with a usage error unless the sets of both levels fit in them
+ */
+static void check_config(const struct cache_config_t& conf)
+{
+    if (conf.c < conf.s + conf.b) {
+        print_err_usage("L1 needs c >= s + b");
+    }
+    if (conf.C < conf.S + conf.b) {
+        print_err_usage("L2 needs C >= S + b");
+    }
+}
+
+/**
+ * @brief Simulate one configuration on one trace
+ */
+static int run_single(const struct cache_config_t& conf_i, const char *path,
+        const window_t& window, bool show_footprint)
+{
+    // stats struct being used by the driver
+    struct cache_stats_t stats;
+    struct cache_footprint_t footprint;
+    struct cache_config_t conf = conf_i;
+    check_config(conf);
+
+    print_config(&conf);
+    init_stats(&stats, conf);
+
+    // Call the init function only once
+    cache_init(&conf);
+
+    // Text or binary trace, detected from the start of the file. It is
+    // decoded on a separate thread while this one runs the cache model,
+    // and back-to-back accesses to the same block arrive collapsed into
+    // runs.
+    std::unique_ptr<TraceReader> reader = open_window(path, window, conf.b);
+    TracePipeline pipeline(*reader, conf.b);
+
+    const trace_batch_t *batch;
+    while ((batch = pipeline.acquire()) != NULL) {
+        cache_access_runs(batch->addr, batch->write, batch->repeat_reads,
+                batch->repeat_writes, batch->n, &stats);
+        pipeline.release();
+    }
+
+    if (show_footprint) {
+        cache_footprint(&footprint);
+    }
+
+    // Cleanup memory and perform any computations you might need to then print statistics
+    cache_cleanup(&stats);
+    print_stats(&stats);
+    if (show_footprint) {
+        print_footprint(&footprint);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Simulate every scenario against every trace
+ *
+ * The scenarios are simulated in lockstep over each trace, so each trace is
+ * decoded once, with runs cut at the smallest block size of all scenarios.
+ */
+static int run_scenarios(std::vector<std::string> scenarios,
+        const struct cache_config_t& base,
+        const std::vector<const char *>& trace_paths, const window_t& window,
+        bool show_footprint)
+{
+    if (scenarios.empty()) {
+        scenarios.push_back("");
+    }
+
+    size_t num_confs = scenarios.size();
+    std::vector<struct cache_config_t> confs;
+    uint64_t min_b = UINT64_MAX;
+    for (size_t sc = 0; sc < num_confs; ++sc) {
+        confs.push_back(parse_scenario(scenarios[sc], base));
+        check_config(confs[sc]);
+        min_b = std::min(min_b, confs[sc].b);
+    }
+
+    // Results of scenario sc on trace t are at t * num_confs + sc
+    std::vector<struct cache_stats_t> all_stats(trace_paths.size() * num_confs);
+    std::vector<struct cache_footprint_t> footprints(all_stats.size());
+    for (size_t t = 0; t < trace_paths.size(); ++t) {
+        struct cache_stats_t *trace_stats = &all_stats[t * num_confs];
+        for (size_t sc = 0; sc < num_confs; ++sc) {
+            init_stats(&trace_stats[sc], confs[sc]);
+        }
+
+        cache_init_lockstep(confs.data(), num_confs);
+        std::unique_ptr<TraceReader> reader = open_window(trace_paths[t],
+                window, min_b);
+        TracePipeline pipeline(*reader, min_b);
+
+        const trace_batch_t *batch;
+        while ((batch = pipeline.acquire()) != NULL) {
+            cache_access_runs_lockstep(batch->addr, batch->write,
+                    batch->repeat_reads, batch->repeat_writes, batch->n,
+                    trace_stats);
+            pipeline.release();
+        }
+        if (show_footprint) {
+            cache_footprint_lockstep(&footprints[t * num_confs]);
+        }
+        cache_cleanup_lockstep(trace_stats);
+    }
+
+    for (size_t sc = 0; sc < num_confs; ++sc) {
+        std::cout << "****************************" << std::endl;
+        std::cout << "*** Scenario: " << (scenarios[sc].empty() ? "default"
+                : scenarios[sc]) << std::endl;
+        std::cout << "****************************" << std::endl;
+
+        for (size_t t = 0; t < trace_paths.size(); ++t) {
+            std::cout << std::endl << "--- " << trace_name(trace_paths[t])
+                      << " ---" << std::endl;
+            print_config(&confs[sc]);
+            print_stats(&all_stats[t * num_confs + sc]);
+            if (show_footprint) {
+                print_footprint(&footprints[t * num_confs + sc]);
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
+
 int main(int argc, char *const argv[])
 {
     int opt;
-    FILE *fin = stdin;
+    std::vector<const char *> trace_paths; // stdin unless -i is given
+    std::vector<std::string> scenarios;
+    window_t window = {0, UINT64_MAX};
+    bool show_footprint = false;
+    bool mattson = false;
+    uint64_t mattson_max_s = 0;
+    const char *all_assoc = NULL;
+    bool sweep = false;
+    std::string sweep_spec;
+    size_t num_threads = std::thread::hardware_concurrency();
 
     struct cache_config_t DEFAULT_CONF;
 
@@ -88,35 +818,41 @@ int main(int argc, char *const argv[])
         print_err_usage("Input file argument not provided");
     }
 
-    while (-1 != (opt = getopt(argc, argv, "c:C:b:B:s:S:i:I:v:V:k:K:h"))) {
+    while (-1 != (opt = getopt_long(argc, argv, "c:C:b:B:s:S:i:I:v:V:k:K:j:h",
+                    LONG_OPTIONS, NULL))) {
+        if (set_config_option(&DEFAULT_CONF, opt, optarg)) {
+            continue;
+        }
         switch (opt) {
-            case 'c':
-                DEFAULT_CONF.c = (uint64_t) atoi(optarg);
+            case 'i':
+            case 'I':
+                trace_paths.push_back(optarg);
                 break;
-            case 'C':
-                DEFAULT_CONF.C = (uint64_t) atoi(optarg);
+            case OPT_START:
+                window.start = strtoull(optarg, NULL, 0);
                 break;
-            case 'b':
-            case 'B': // Just incase someone decides to pass 'B' for the block size
-                DEFAULT_CONF.b = (uint64_t) atoi(optarg);
+            case OPT_COUNT:
+                window.count = strtoull(optarg, NULL, 0);
                 break;
-            case 's':
-                DEFAULT_CONF.s = (uint64_t) atoi(optarg);
+            case OPT_SCENARIO:
+                scenarios.push_back(optarg);
                 break;
-            case 'S':
-                DEFAULT_CONF.S = (uint64_t) atoi(optarg);
+            case OPT_FOOTPRINT:
+                show_footprint = true;
                 break;
-            case 'v':
-            case 'V':
-                DEFAULT_CONF.v = (uint64_t) atoi(optarg);
+            case OPT_MATTSON:
+                mattson = true;
+                mattson_max_s = strtoull(optarg, NULL, 0);
                 break;
-            case 'k':
-            case 'K':
-                DEFAULT_CONF.k = (uint64_t) atoi(optarg);
+            case OPT_ALL_ASSOC:
+                all_assoc = optarg;
                 break;
-            case 'i':
-            case 'I':
-                fin = fopen(optarg, "r");
+            case OPT_SWEEP:
+                sweep = true;
+                sweep_spec += std::string(optarg) + " ";
+                break;
+            case 'j':
+                num_threads = strtoull(optarg, NULL, 0);
                 break;
             case 'h':
             default:
@@ -125,35 +861,35 @@ int main(int argc, char *const argv[])
         }
     }
 
-    print_config(&DEFAULT_CONF);
-
-    // stats struct being used by the driver
-    struct cache_stats_t stats;
-    memset(&stats, 0, sizeof(struct cache_stats_t));
+    if (trace_paths.empty()) {
+        trace_paths.push_back(NULL);
+    }
 
-    // Set access times for each level of the memory hierarchy
-    stats.hit_time_l1 = HIT_TIME_L1_BASE + ADJUSTMENT_FACTOR_L1 * (double) DEFAULT_CONF.s;
-    stats.hit_time_l2 = HIT_TIME_L2_BASE + ADJUSTMENT_FACTOR_L2 * (double) DEFAULT_CONF.S;
-    stats.hit_time_mem = HIT_TIME_MEM;
+    if (sweep) {
+        // "--sweep c=12..16 s=0..4" leaves the ranges after the first as
+        // plain arguments
+        for (int i = optind; i < argc; ++i) {
+            sweep_spec += std::string(argv[i]) + " ";
+        }
+        return run_sweep(sweep_spec, DEFAULT_CONF, trace_paths, window,
+                num_threads);
+    }
 
-    // Call the init function only once
-    cache_init(&DEFAULT_CONF);
+    if (mattson) {
+        return run_mattson(DEFAULT_CONF, mattson_max_s, trace_paths, window);
+    }
 
-    char rw;
-    uint64_t addr;
-    while (!feof(fin)) {
-        // Don't change this line if you want this to work!
-        int ret = fscanf(fin, "%" PRIx64 " %c\n", &addr, &rw);
-        if (ret == 2) {
-            // Perform accesses -- one at a time
-            cache_access(addr, rw, &stats);
-        }
+    if (all_assoc) {
+        return run_all_assoc(all_assoc, DEFAULT_CONF, trace_paths, window);
     }
-    fclose(fin);
 
-    // Cleanup memory and perform any computations you might need to then print statistics
-    cache_cleanup(&stats);
-    print_stats(&stats);
+    if (trace_paths.size() == 1 && scenarios.size() <= 1) {
+        return run_single(scenarios.empty() ? DEFAULT_CONF
+                : parse_scenario(scenarios[0], DEFAULT_CONF), trace_paths[0],
+                window, show_footprint);
+    }
 
-    return 0;
+    // Several runs: every scenario against every trace
+    return run_scenarios(scenarios, DEFAULT_CONF, trace_paths, window,
+            show_footprint);
 }
@@ -0,0 +1,232 @@
+/**
+ * @file cache_engine.cpp
+ * @brief Tag matchers and the engine dispatch table
+ */
+
+#include "cache_engine.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CACHE_HAVE_SIMD 1
+#include <immintrin.h>
+#else
+#define CACHE_HAVE_SIMD 0
+#endif
+
+static uint64_t matchTagsScalar(const uint64_t *tags, uint64_t n, uint64_t tag)
+{
+    uint64_t hits = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        hits |= static_cast<uint64_t>(tags[i] == tag) << i;
+    }
+    return hits;
+}
+
+#if CACHE_HAVE_SIMD
+
+static uint64_t matchTagsSse2(const uint64_t *tags, uint64_t n, uint64_t tag)
+{
+    __m128i probe = _mm_set1_epi64x(static_cast<long long>(tag));
+    uint64_t hits = 0;
+    uint64_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        // No 64-bit compare in SSE2: both 32-bit halves have to match
+        __m128i eq = _mm_cmpeq_epi32(probe, _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(tags + i)));
+        eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+        hits |= static_cast<uint64_t>(
+                _mm_movemask_pd(_mm_castsi128_pd(eq))) << i;
+    }
+    if (i < n) {
+        hits |= matchTagsScalar(tags + i, n - i, tag) << i;
+    }
+    return hits;
+}
+
+__attribute__((target("avx2")))
+static uint64_t matchTagsAvx2(const uint64_t *tags, uint64_t n, uint64_t tag)
+{
+    __m256i probe = _mm256_set1_epi64x(static_cast<long long>(tag));
+    uint64_t hits = 0;
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i eq = _mm256_cmpeq_epi64(probe, _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(tags + i)));
+        hits |= static_cast<uint64_t>(
+                _mm256_movemask_pd(_mm256_castsi256_pd(eq))) << i;
+    }
+    if (i < n) {
+        hits |= matchTagsSse2(tags + i, n - i, tag) << i;
+    }
+    return hits;
+}
+
+static TagMatcher pickTagMatcher()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return matchTagsAvx2;
+    }
+    return matchTagsSse2;
+}
+
+const TagMatcher MATCH_TAGS = pickTagMatcher();
+
+#else
+
+const TagMatcher MATCH_TAGS = matchTagsScalar;
+
+#endif // CACHE_HAVE_SIMD
+
+static const size_t HUGE_PAGE_SIZE = 2UL << 20;
+
+static size_t roundUp(size_t bytes, size_t to)
+{
+    return (bytes + to - 1UL) & ~(to - 1UL);
+}
+
+static void *mapAnonymous(size_t len)
+{
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+static void slabFail(size_t bytes)
+{
+    std::cout << "could not allocate " << bytes << " bytes of cache state"
+        << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+void *slabMap(size_t bytes, size_t *mapped)
+{
+    if (bytes < HUGE_PAGE_SIZE) {
+        *mapped = roundUp(bytes, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+        void *map = mapAnonymous(*mapped);
+        if (map == NULL) {
+            slabFail(bytes);
+        }
+        return map;
+    }
+
+    // Align to 2 MB so huge pages can back all of it once advised, and trim
+    // the slack on either side
+    *mapped = roundUp(bytes, HUGE_PAGE_SIZE);
+    char *map = static_cast<char *>(mapAnonymous(*mapped + HUGE_PAGE_SIZE));
+    if (map == NULL) {
+        slabFail(bytes);
+    }
+    char *aligned = map + (HUGE_PAGE_SIZE
+            - reinterpret_cast<uintptr_t>(map) % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+    size_t head = static_cast<size_t>(aligned - map);
+    if (head) {
+        munmap(map, head);
+    }
+    if (HUGE_PAGE_SIZE - head) {
+        munmap(aligned + *mapped, HUGE_PAGE_SIZE - head);
+    }
+    return aligned;
+}
+
+void slabZero(void *slab, size_t bytes, size_t mapped)
+{
+    if (mapped < HUGE_PAGE_SIZE) {
+        memset(slab, 0, bytes);
+        return;
+    }
+#ifdef MADV_NOHUGEPAGE
+    madvise(slab, mapped, MADV_NOHUGEPAGE);
+#endif
+    // Private anonymous pages read as zeros again once dropped
+    if (madvise(slab, mapped, MADV_DONTNEED) != 0) {
+        memset(slab, 0, bytes);
+    }
+}
+
+void slabAdviseHuge(void *slab, size_t mapped)
+{
+#ifdef MADV_HUGEPAGE
+    if (mapped >= HUGE_PAGE_SIZE) {
+        madvise(slab, mapped, MADV_HUGEPAGE);
+    }
+#endif
+}
+
+void slabUnmap(void *slab, size_t mapped)
+{
+    munmap(slab, mapped);
+}
+
+/**
+ * @brief The specialized engines
+ *
+ * The defaults from cache.hpp are specialized in both levels. For the sweep
+ * grid, c = 12..16 and s = 0..4 with b = 6, only L1 is: it is looked up on
+ * every access while L2 only sees L1 misses, and specializing both would
+ * take the product of the two grids.
+ */
+typedef FixedGeometry<DEFAULT_c, DEFAULT_s, DEFAULT_b> DefaultL1Geometry;
+typedef FixedGeometry<DEFAULT_C, DEFAULT_S, DEFAULT_b> DefaultL2Geometry;
+
+template class Engine<DefaultL1Geometry, DefaultL2Geometry>;
+template class Engine<DynamicGeometry, DynamicGeometry>;
+
+#define ENGINE_SWEEP_GRID(X) \
+    X(12, 0) X(12, 1) X(12, 2) X(12, 3) X(12, 4) \
+    X(13, 0) X(13, 1) X(13, 2) X(13, 3) X(13, 4) \
+    X(14, 0) X(14, 1) X(14, 2) X(14, 3) X(14, 4) \
+    X(15, 0) X(15, 1) X(15, 2) X(15, 3) X(15, 4) \
+    X(16, 0) X(16, 1) X(16, 2) X(16, 3) X(16, 4)
+
+#define ENGINE_SWEEP_INSTANTIATE(c, s) \
+    template class Engine<FixedGeometry<c, s, 6>, DynamicGeometry>;
+ENGINE_SWEEP_GRID(ENGINE_SWEEP_INSTANTIATE)
+#undef ENGINE_SWEEP_INSTANTIATE
+
+template <class L1G, class L2G>
+static CacheEngine *createEngine(const struct cache_config_t& conf)
+{
+    return new Engine<L1G, L2G>(conf);
+}
+
+/**
+ * A dispatch table row matches a configuration on (c, s, b), and on (C, S)
+ * unless those are ANY_GEOMETRY
+ */
+static const uint64_t ANY_GEOMETRY = UINT64_MAX;
+
+struct engine_dispatch_t
+{
+    uint64_t c, s, C, S, b;
+    CacheEngineFactory create;
+};
+
+#define ENGINE_SWEEP_ROW(c, s) \
+    {c, s, ANY_GEOMETRY, ANY_GEOMETRY, 6, \
+        createEngine<FixedGeometry<c, s, 6>, DynamicGeometry>},
+
+static const engine_dispatch_t ENGINE_TABLE[] = {
+    {DEFAULT_c, DEFAULT_s, DEFAULT_C, DEFAULT_S, DEFAULT_b,
+        createEngine<DefaultL1Geometry, DefaultL2Geometry>},
+    ENGINE_SWEEP_GRID(ENGINE_SWEEP_ROW)
+};
+#undef ENGINE_SWEEP_ROW
+
+CacheEngineFactory findCacheEngine(const struct cache_config_t& conf)
+{
+    for (const engine_dispatch_t& row : ENGINE_TABLE) {
+        if (row.c == conf.c && row.s == conf.s && row.b == conf.b
+                && (row.C == ANY_GEOMETRY || row.C == conf.C)
+                && (row.S == ANY_GEOMETRY || row.S == conf.S)) {
+            return row.create;
+        }
+    }
+    return createEngine<DynamicGeometry, DynamicGeometry>;
+}
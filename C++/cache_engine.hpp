@@ -0,0 +1,1802 @@
+/**
+ * @file cache_engine.hpp
+ * @brief Cache levels and the engine simulating a whole cache hierarchy
+ *
+ * Every level is templated on its geometry. FixedGeometry bakes (c, s, b)
+ * into the type so index and tag extraction constant-fold and way loops
+ * have constant trip counts; DynamicGeometry takes them at run time. An
+ * Engine combines an L1 and an L2 geometry, and findCacheEngine() picks a
+ * specialized Engine for common configurations from a dispatch table,
+ * falling back to the fully dynamic one.
+ */
+
+#ifndef CACHE_ENGINE_H
+#define CACHE_ENGINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "cache.hpp"
+
+/**
+ * @brief Useful function for finding number of bits needed to represent number
+ */
+inline uint64_t clog2(uint64_t num)
+{
+
+    return static_cast<uint64_t>(std::ceil(std::log2(num)));
+}
+
+/**
+ * @brief A cache block moving between the levels
+ *
+ * The block address (address >> b) travels next to the status flags rather
+ * than sharing a word with them: with b < 2 a block address can need all 64
+ * bits. How a block address splits into tag and index is a property of the
+ * level holding the block, not of the block.
+ */
+struct block_t
+{
+    uint64_t address;
+    uint64_t flags;
+};
+
+static const uint64_t BLOCK_DIRTY = 1UL;
+static const uint64_t BLOCK_PREFETCHED = 2UL;
+
+inline block_t makeBlock(uint64_t blockAddress, bool dirty,
+        bool prefetched = false)
+{
+    block_t block = {blockAddress, (dirty ? BLOCK_DIRTY : 0UL)
+        | (prefetched ? BLOCK_PREFETCHED : 0UL)};
+    return block;
+}
+
+inline uint64_t blockAddress(block_t block)
+{
+    return block.address;
+}
+
+inline bool isDirty(block_t block)
+{
+    return (block.flags & BLOCK_DIRTY) != 0;
+}
+
+inline bool isPrefetched(block_t block)
+{
+    return (block.flags & BLOCK_PREFETCHED) != 0;
+}
+
+/**
+ * @brief Outcome of a lookup or an insertion
+ *
+ * For lookups, found tells whether the block was resident and block is its
+ * current state. For insertions, found tells whether a block had to be
+ * evicted and block is the evicted block.
+ */
+struct block_result_t
+{
+    bool found;
+    block_t block;
+};
+
+static const block_result_t BLOCK_NONE = {false, {0, 0}};
+
+inline block_result_t blockFound(block_t block)
+{
+    block_result_t result = {true, block};
+    return result;
+}
+
+/**
+ * @brief How block addresses map onto the sets of a level, set at run time
+ */
+class DynamicGeometry
+{
+    private:
+        uint64_t c, b, s;
+        uint64_t ways;
+        uint64_t indexBits;
+        uint64_t numSets;
+    public:
+        DynamicGeometry()
+            : c(0), b(0), s(0), ways(0), indexBits(0), numSets(1)
+        {}
+
+        /**
+         * @param ways_i the number of ways, normally 2^s_i
+         */
+        void init(uint64_t c_i, uint64_t b_i, uint64_t s_i, uint64_t ways_i)
+        {
+            c = c_i;
+            b = b_i;
+            s = s_i;
+            ways = ways_i;
+            indexBits = c - s - b;
+            numSets = 1UL << indexBits;
+        }
+
+        /**
+         * Whether init() can take this configuration
+         */
+        bool fits(uint64_t, uint64_t, uint64_t) const
+        {
+            return true;
+        }
+
+        uint64_t getC() const { return c; }
+        uint64_t getB() const { return b; }
+        uint64_t getS() const { return s; }
+        uint64_t getWays() const { return ways; }
+        uint64_t getNumSets() const { return numSets; }
+
+        uint64_t index(uint64_t blockAddress) const
+        {
+            return blockAddress & (numSets - 1UL);
+        }
+
+        uint64_t tag(uint64_t blockAddress) const
+        {
+            return blockAddress >> indexBits;
+        }
+
+        uint64_t blockAddress(uint64_t tag, uint64_t index) const
+        {
+            return (tag << indexBits) | index;
+        }
+}; // DynamicGeometry
+
+/**
+ * @brief How block addresses map onto the sets of a level, fixed at compile
+ * time
+ *
+ * Same interface as DynamicGeometry; init() is a no-op because the engine
+ * dispatch only picks this geometry for a matching configuration, and an
+ * engine only takes a new configuration if it fits().
+ */
+template <uint64_t C, uint64_t S, uint64_t B>
+class FixedGeometry
+{
+    public:
+        void init(uint64_t, uint64_t, uint64_t, uint64_t)
+        {}
+
+        constexpr bool fits(uint64_t c_i, uint64_t b_i, uint64_t s_i) const
+        {
+            return c_i == C && b_i == B && s_i == S;
+        }
+
+        constexpr uint64_t getC() const { return C; }
+        constexpr uint64_t getB() const { return B; }
+        constexpr uint64_t getS() const { return S; }
+        constexpr uint64_t getWays() const { return 1UL << S; }
+        constexpr uint64_t getNumSets() const { return 1UL << (C - S - B); }
+
+        constexpr uint64_t index(uint64_t blockAddress) const
+        {
+            return blockAddress & ((1UL << (C - S - B)) - 1UL);
+        }
+
+        constexpr uint64_t tag(uint64_t blockAddress) const
+        {
+            return blockAddress >> (C - S - B);
+        }
+
+        constexpr uint64_t blockAddress(uint64_t tag, uint64_t index) const
+        {
+            return (tag << (C - S - B)) | index;
+        }
+}; // FixedGeometry
+
+/**
+ * @brief Map at least bytes of zeroed memory for a Slab
+ *
+ * Slabs of 2 MB or more are mapped 2 MB aligned, so that transparent huge
+ * pages can back all of them once slabAdviseHuge() asks for it.
+ *
+ * @param mapped set to the number of bytes actually mapped
+ */
+void *slabMap(size_t bytes, size_t *mapped);
+
+/**
+ * @brief Zero the first bytes of a slab for reuse
+ *
+ * Slabs of 2 MB or more hand their pages back to the kernel instead, so
+ * the cost is proportional to the pages that were materialized, and they
+ * go back to small pages until advised again.
+ */
+void slabZero(void *slab, size_t bytes, size_t mapped);
+
+/**
+ * @brief Ask for transparent huge pages behind a slab of 2 MB or more
+ *
+ * Random set indexing into a large tag store then misses the TLB far less
+ * often. A huge page is materialized as a whole, though, so this only pays
+ * off for slabs that are densely used.
+ */
+void slabAdviseHuge(void *slab, size_t mapped);
+
+void slabUnmap(void *slab, size_t mapped);
+
+/**
+ * @brief Fixed size array for the bulk state of a cache level
+ *
+ * Memory comes straight from slabMap(), and is reused by later assign()
+ * calls that fit in it. A fresh or re-zeroed mapping reads as zeros
+ * without any physical memory behind it, so assigning zeros writes
+ * nothing: a page is only materialized when the simulation first stores
+ * to it, and the footprint of a huge, sparsely used level follows the
+ * trace's working set rather than the configured capacity. A slab stays
+ * on small pages until its owner calls adviseHugePages().
+ *
+ * Linux places a page on the NUMA node of the thread that first writes
+ * it. Engines created and run by the worker threads of a sweep thus keep
+ * their state local to those workers.
+ *
+ * Only meant for plain integer types; the memory is never constructed.
+ */
+template <class T>
+class Slab
+{
+    private:
+        T *items;
+        size_t count;
+        size_t mapped;
+
+    public:
+        Slab() : items(NULL), count(0), mapped(0)
+        {}
+
+        Slab(const Slab&) = delete;
+        Slab& operator=(const Slab&) = delete;
+
+        ~Slab()
+        {
+            clear();
+        }
+
+        /**
+         * Resize to n zeroed elements, keeping the mapping if it is large
+         * enough
+         */
+        void assign(size_t n)
+        {
+            if (n * sizeof(T) > mapped || n == 0) {
+                clear();
+            }
+            if (n && !items) {
+                items = static_cast<T *>(slabMap(n * sizeof(T), &mapped));
+            } else if (n) {
+                slabZero(items, n * sizeof(T), mapped);
+            }
+            count = n;
+        }
+
+        /**
+         * Back the slab with huge pages, once it is known to be dense
+         */
+        void adviseHugePages()
+        {
+            if (items) {
+                slabAdviseHuge(items, mapped);
+            }
+        }
+
+        void clear()
+        {
+            if (items) {
+                slabUnmap(items, mapped);
+            }
+            items = NULL;
+            count = 0;
+            mapped = 0;
+        }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        T& operator[](size_t i) { return items[i]; }
+        const T& operator[](size_t i) const { return items[i]; }
+}; // Slab
+
+/**
+ * @brief Bitset with one bit per way slot of a cache
+ */
+class SlotBits
+{
+    private:
+        Slab<uint64_t> words;
+    public:
+        void assign(uint64_t numSlots)
+        {
+            words.assign((numSlots + 63UL) / 64UL);
+        }
+
+        void adviseHugePages()
+        {
+            words.adviseHugePages();
+        }
+
+        bool test(uint64_t slot) const
+        {
+            return (words[slot >> 6] >> (slot & 63UL)) & 1UL;
+        }
+
+        void set(uint64_t slot, bool val)
+        {
+            uint64_t bit = 1UL << (slot & 63UL);
+            if (val) {
+                words[slot >> 6] |= bit;
+            } else {
+                words[slot >> 6] &= ~bit;
+            }
+        }
+
+        /**
+         * Bits [first, first + n) as a word, for n <= 64
+         */
+        uint64_t bits(uint64_t first, uint64_t n) const
+        {
+            uint64_t shift = first & 63UL;
+            uint64_t val = words[first >> 6] >> shift;
+            if (shift + n > 64UL) {
+                val |= words[(first >> 6) + 1] << (64UL - shift);
+            }
+            return n < 64UL ? val & ((1UL << n) - 1UL) : val;
+        }
+
+        /**
+         * Offset of the first clear bit in [first, first + n), n if none
+         */
+        uint64_t findClear(uint64_t first, uint64_t n) const
+        {
+            for (uint64_t i = first; i < first + n; ) {
+                uint64_t bit = i & 63UL;
+                uint64_t clear = ~words[i >> 6] >> bit;
+                if (clear) {
+                    uint64_t at = i + static_cast<uint64_t>(__builtin_ctzl(clear));
+                    return at < first + n ? at - first : n;
+                }
+                i += 64UL - bit;
+            }
+            return n;
+        }
+}; // SlotBits
+
+/**
+ * @brief Compare up to 64 stored tags against a probe
+ *
+ * Bit i of the result is set if tags[i] == tag. The SIMD versions compare
+ * 4 (AVX2) or 2 (SSE2) tags per instruction and collect the results with a
+ * movemask; the one used is picked once at startup from CPUID.
+ */
+typedef uint64_t (*TagMatcher)(const uint64_t *tags, uint64_t n, uint64_t tag);
+
+extern const TagMatcher MATCH_TAGS;
+
+/**
+ * Sets with a compile-time way count up to this wide compare their tags
+ * inline
+ */
+static const uint64_t INLINE_MATCH_MAX_WAYS = 16;
+
+/**
+ * @brief Tag compare of sets whose way count is only known at run time
+ */
+struct DynamicTagMatcher
+{
+    static uint64_t match(const uint64_t *tags, uint64_t n, uint64_t tag)
+    {
+        return MATCH_TAGS(tags, n, tag);
+    }
+};
+
+/**
+ * @brief Tag compare of sets of WAYS ways, fixed at compile time
+ *
+ * Narrow sets unroll into WAYS plain compares in the lookup itself, which
+ * beats a call through MATCH_TAGS for a handful of tags; wider ones still
+ * take the SIMD matcher.
+ */
+template <uint64_t WAYS, bool UNROLL = (WAYS <= INLINE_MATCH_MAX_WAYS)>
+struct FixedTagMatcher
+{
+    static uint64_t match(const uint64_t *tags, uint64_t n, uint64_t tag)
+    {
+        return MATCH_TAGS(tags, n, tag);
+    }
+};
+
+template <uint64_t WAYS>
+struct FixedTagMatcher<WAYS, true>
+{
+    static uint64_t match(const uint64_t *tags, uint64_t, uint64_t tag)
+    {
+        return FixedTagMatcher<WAYS - 1, true>::match(tags, WAYS - 1, tag)
+            | static_cast<uint64_t>(tags[WAYS - 1] == tag) << (WAYS - 1);
+    }
+};
+
+template <>
+struct FixedTagMatcher<0, true>
+{
+    static uint64_t match(const uint64_t *, uint64_t, uint64_t)
+    {
+        return 0;
+    }
+};
+
+/**
+ * @brief The tag compare a level of geometry G uses
+ */
+template <class G>
+struct TagMatcherOf
+{
+    typedef DynamicTagMatcher type;
+};
+
+template <uint64_t C, uint64_t S, uint64_t B>
+struct TagMatcherOf<FixedGeometry<C, S, B> >
+{
+    typedef FixedTagMatcher<(1UL << S)> type;
+};
+
+/**
+ * @brief Struct-of-arrays storage for the blocks of one cache
+ *
+ * Way w of set i lives in slot (i << s) + w of every array. A block is just
+ * its tag and three status bits; the rest of its address follows from the
+ * set it is in.
+ */
+struct TagStore
+{
+    Slab<uint64_t> tags;
+    SlotBits valid;
+    SlotBits dirty;
+    SlotBits prefetched;
+
+    void init(uint64_t numSlots)
+    {
+        tags.assign(numSlots);
+        valid.assign(numSlots);
+        dirty.assign(numSlots);
+        prefetched.assign(numSlots);
+    }
+
+    void adviseHugePages()
+    {
+        tags.adviseHugePages();
+        valid.adviseHugePages();
+        dirty.adviseHugePages();
+        prefetched.adviseHugePages();
+    }
+}; // TagStore
+
+/**
+ * Sets with at most this many ways keep their list order in a PackedOrder
+ */
+static const uint64_t PACKED_ORDER_MAX_WAYS = 16;
+
+/**
+ * Order of a packed set nobody has touched: way i at position i
+ */
+static const uint64_t PACKED_ORDER_IDENTITY = 0xfedcba9876543210UL;
+
+/**
+ * Sets with at least this many ways find tags through a TagIndex instead of
+ * comparing every way
+ */
+static const uint64_t TAG_INDEX_MIN_WAYS = 128;
+
+/**
+ * A level whose materialized sets reach this fraction (1 / divisor) of all
+ * its sets moves to huge pages
+ */
+static const uint64_t DENSE_SETS_DIVISOR = 4;
+
+/**
+ * @brief Exact list order of a set of up to 16 ways, packed into one word
+ *
+ * Nibble i holds the way at list position i. Every way appears exactly
+ * once: positions below the set's size hold its blocks, the rest its free
+ * ways. Moving a way to the head is a handful of shifts and masks on the
+ * word, with no memory traffic beyond the word itself.
+ */
+class PackedOrder
+{
+    private:
+        static const uint64_t NIBBLE_LOWS = 0x1111111111111111UL;
+        static const uint64_t NIBBLE_HIGHS = 0x8888888888888888UL;
+
+        /**
+         * Mask of the nibbles at positions [0, n)
+         */
+        static uint64_t below(uint64_t n)
+        {
+            return n >= 16 ? ~0UL : (1UL << (4 * n)) - 1UL;
+        }
+
+    public:
+        static uint64_t wayAt(uint64_t order, uint64_t pos)
+        {
+            return (order >> (4 * pos)) & 0xfUL;
+        }
+
+        /**
+         * List position of way, found by testing all nibbles at once for
+         * being equal to it
+         */
+        static uint64_t positionOf(uint64_t order, uint64_t way)
+        {
+            uint64_t diff = order ^ (way * NIBBLE_LOWS);
+            uint64_t low = ~NIBBLE_HIGHS;
+            uint64_t zero = ~(((diff & low) + low) | diff | low);
+            return static_cast<uint64_t>(__builtin_ctzl(zero)) / 4;
+        }
+
+        /**
+         * Move the way at pos to position 0, shifting positions [0, pos) up
+         */
+        static uint64_t moveToFront(uint64_t order, uint64_t pos)
+        {
+            uint64_t head = order & below(pos);
+            return (order & ~below(pos + 1)) | (head << 4) | wayAt(order, pos);
+        }
+}; // PackedOrder
+
+/**
+ * @brief Exact list order of wide sets, as circular doubly linked lists
+ * threaded through arrays
+ *
+ * Links are way numbers indexed like the TagStore slots, so a list never
+ * allocates. Only resident ways are linked; the tail is the predecessor of
+ * the head.
+ */
+struct WayList
+{
+    Slab<uint32_t> heads;
+    Slab<uint32_t> next;
+    Slab<uint32_t> prev;
+
+    void init(uint64_t numSets, uint64_t numSlots)
+    {
+        heads.assign(numSets);
+        next.assign(numSlots);
+        prev.assign(numSlots);
+    }
+
+    void clear()
+    {
+        heads.clear();
+        next.clear();
+        prev.clear();
+    }
+
+    void adviseHugePages()
+    {
+        heads.adviseHugePages();
+        next.adviseHugePages();
+        prev.adviseHugePages();
+    }
+}; // WayList
+
+/**
+ * @brief Open-addressed map from tag to way for each set of a wide level
+ *
+ * Set i owns buckets [i * bucketsPerSet, (i + 1) * bucketsPerSet), at least
+ * twice as many as it has ways, so probe sequences stay short. A bucket
+ * holds way + 1, or 0 when empty. Collisions probe linearly, and removal
+ * shifts later members of the cluster back instead of leaving tombstones.
+ */
+class TagIndex
+{
+    private:
+        Slab<uint32_t> buckets;
+        uint64_t bucketBits;
+
+        uint64_t home(uint64_t tag) const
+        {
+            // Fibonacci hashing; the high bits of the product mix best
+            return (tag * 0x9e3779b97f4a7c15UL) >> (64 - bucketBits);
+        }
+
+        uint64_t bucketMask() const
+        {
+            return (1UL << bucketBits) - 1UL;
+        }
+
+    public:
+        TagIndex() : bucketBits(0)
+        {}
+
+        void init(uint64_t numSets, uint64_t ways)
+        {
+            bucketBits = clog2(ways) + 1;
+            buckets.assign(numSets << bucketBits);
+        }
+
+        void clear()
+        {
+            buckets.clear();
+        }
+
+        void adviseHugePages()
+        {
+            buckets.adviseHugePages();
+        }
+
+        /**
+         * Way of set holding tag according to tags, the set's slice of the
+         * TagStore; ways if there is none
+         */
+        uint64_t find(uint64_t set, uint64_t tag, const uint64_t *tags,
+                uint64_t ways) const
+        {
+            const uint32_t *setBuckets = &buckets[set << bucketBits];
+            for (uint64_t i = home(tag); setBuckets[i];
+                    i = (i + 1UL) & bucketMask()) {
+                if (tags[setBuckets[i] - 1U] == tag) {
+                    return setBuckets[i] - 1U;
+                }
+            }
+            return ways;
+        }
+
+        void insert(uint64_t set, uint64_t tag, uint64_t way)
+        {
+            uint32_t *setBuckets = &buckets[set << bucketBits];
+            uint64_t i = home(tag);
+            while (setBuckets[i]) {
+                i = (i + 1UL) & bucketMask();
+            }
+            setBuckets[i] = static_cast<uint32_t>(way + 1UL);
+        }
+
+        /**
+         * Remove way, which holds tag, from the index of set
+         */
+        void remove(uint64_t set, uint64_t tag, uint64_t way,
+                const uint64_t *tags)
+        {
+            uint32_t *setBuckets = &buckets[set << bucketBits];
+            uint64_t hole = home(tag);
+            while (setBuckets[hole] != way + 1UL) {
+                hole = (hole + 1UL) & bucketMask();
+            }
+            // Pull back every later member that may not probe past the hole
+            uint64_t i = hole;
+            for (;;) {
+                i = (i + 1UL) & bucketMask();
+                if (!setBuckets[i]) {
+                    break;
+                }
+                uint64_t want = home(tags[setBuckets[i] - 1U]);
+                if (((i - want) & bucketMask()) >= ((i - hole) & bucketMask())) {
+                    setBuckets[hole] = setBuckets[i];
+                    hole = i;
+                }
+            }
+            setBuckets[hole] = 0U;
+        }
+}; // TagIndex
+
+/**
+ * @brief Storage and set bookkeeping shared by every cache level
+ *
+ * Set i is a view of slots [i << s, (i + 1) << s) of the level's TagStore.
+ * Blocks stay in the way they were filled into; only the list order of the
+ * ways changes, which keeps the stack nature of LRU: the head of a set's
+ * list is its MRU block and the tail its LRU block.
+ *
+ * Every structure of a set starts out as zero bits, so a set costs no
+ * memory until it first receives a block. Once a quarter of the sets have
+ * received one, the level asks for huge pages.
+ *
+ * Sets of up to PACKED_ORDER_MAX_WAYS ways keep their order in a
+ * PackedOrder word, wider sets in a WayList. Sets of TAG_INDEX_MIN_WAYS ways
+ * or more also keep a TagIndex, so neither a lookup nor a recency update
+ * costs time proportional to the associativity. For a FixedGeometry the
+ * choice between them folds away at compile time.
+ */
+template <class G>
+class CacheLevel
+{
+    protected:
+        G geom;
+
+        /**
+         * @brief Primary data structure used for storing cache entries
+         * This is the structure that will be searched for tags, etc.
+         */
+        TagStore store;
+
+        /**
+         * Number of resident blocks in each set
+         */
+        Slab<uint32_t> sizes;
+
+        /**
+         * List order of each set: one PackedOrder word per set for narrow
+         * sets, a WayList for wide ones
+         *
+         * Packed orders are stored XORed with PACKED_ORDER_IDENTITY so that
+         * every structure of an untouched set is all zero bits.
+         */
+        Slab<uint64_t> packedOrder;
+        WayList list;
+
+        TagIndex tagIndex;
+
+        /**
+         * Number of sets that have held a block
+         */
+        uint64_t materialized;
+
+        bool packed() const
+        {
+            return geom.getWays() <= PACKED_ORDER_MAX_WAYS;
+        }
+
+        bool indexed() const
+        {
+            return geom.getWays() >= TAG_INDEX_MIN_WAYS;
+        }
+
+        /**
+         * Number of materialized sets from which on the level is dense
+         * enough to be worth backing with huge pages
+         */
+        uint64_t denseSets() const
+        {
+            return (geom.getNumSets() + DENSE_SETS_DIVISOR - 1UL)
+                / DENSE_SETS_DIVISOR;
+        }
+
+        void adviseHugePages()
+        {
+            store.adviseHugePages();
+            sizes.adviseHugePages();
+            packedOrder.adviseHugePages();
+            list.adviseHugePages();
+            tagIndex.adviseHugePages();
+        }
+
+        uint64_t orderOf(uint64_t set) const
+        {
+            return packedOrder[set] ^ PACKED_ORDER_IDENTITY;
+        }
+
+        void setOrder(uint64_t set, uint64_t order)
+        {
+            packedOrder[set] = order ^ PACKED_ORDER_IDENTITY;
+        }
+
+        /**
+         * Way of set holding tag, ways if there is none
+         *
+         * Tags are matched 64 ways at a time and masked with the valid bits,
+         * so the hit way is the lowest set bit of the result. The compare
+         * comes from TagMatcherOf, so narrow fixed geometries match inline.
+         */
+        uint64_t find(uint64_t set, uint64_t tag) const
+        {
+            typedef typename TagMatcherOf<G>::type Matcher;
+
+            uint64_t base = set << geom.getS();
+            const uint64_t *tags = &store.tags[base];
+            if (indexed()) {
+                return tagIndex.find(set, tag, tags, geom.getWays());
+            }
+            for (uint64_t first = 0; first < geom.getWays(); first += 64UL) {
+                uint64_t n = std::min(geom.getWays() - first, 64UL);
+                uint64_t hits = Matcher::match(tags + first, n, tag)
+                    & store.valid.bits(base + first, n);
+                if (hits) {
+                    return first + static_cast<uint64_t>(__builtin_ctzl(hits));
+                }
+            }
+            return geom.getWays();
+        }
+
+        /**
+         * Way at the head of a set that is not empty
+         */
+        uint64_t headWay(uint64_t set) const
+        {
+            if (packed()) {
+                return PackedOrder::wayAt(orderOf(set), 0);
+            }
+            return list.heads[set];
+        }
+
+        /**
+         * Way at the tail of a set that is not empty
+         */
+        uint64_t tailWay(uint64_t set) const
+        {
+            if (packed()) {
+                return PackedOrder::wayAt(orderOf(set), sizes[set] - 1UL);
+            }
+            return list.prev[(set << geom.getS()) + list.heads[set]];
+        }
+
+        /**
+         * List position of a resident way, 0 for the head
+         *
+         * Wide sets walk their list from the head, so this costs time
+         * proportional to the position
+         */
+        uint64_t position(uint64_t set, uint64_t way) const
+        {
+            if (packed()) {
+                return PackedOrder::positionOf(orderOf(set), way);
+            }
+            uint64_t base = set << geom.getS();
+            uint64_t pos = 0;
+            for (uint32_t at = list.heads[set]; at != way;
+                    at = list.next[base + at]) {
+                ++pos;
+            }
+            return pos;
+        }
+
+        /**
+         * The block held in a way
+         */
+        block_t blockAt(uint64_t set, uint64_t way) const
+        {
+            uint64_t slot = (set << geom.getS()) + way;
+            return makeBlock(geom.blockAddress(store.tags[slot], set),
+                    store.dirty.test(slot), store.prefetched.test(slot));
+        }
+
+        /**
+         * Fill a way with block, replacing whatever it held
+         */
+        void fill(uint64_t set, uint64_t way, block_t block)
+        {
+            uint64_t slot = (set << geom.getS()) + way;
+            uint64_t tag = geom.tag(blockAddress(block));
+            if (indexed()) {
+                if (store.valid.test(slot)) {
+                    tagIndex.remove(set, store.tags[slot], way,
+                            &store.tags[set << geom.getS()]);
+                }
+                tagIndex.insert(set, tag, way);
+            }
+            store.tags[slot] = tag;
+            store.valid.set(slot, true);
+            store.dirty.set(slot, isDirty(block));
+            store.prefetched.set(slot, isPrefetched(block));
+        }
+
+        /**
+         * Move a resident way to the head of its set
+         */
+        void moveToFront(uint64_t set, uint64_t way)
+        {
+            if (packed()) {
+                uint64_t order = orderOf(set);
+                setOrder(set, PackedOrder::moveToFront(order,
+                            PackedOrder::positionOf(order, way)));
+                return;
+            }
+            uint64_t base = set << geom.getS();
+            uint32_t head = list.heads[set];
+            if (way == head) {
+                return;
+            }
+            uint32_t tail = list.prev[base + head];
+            if (way != tail) { // unlink, then relink between tail and head
+                uint32_t before = list.prev[base + way];
+                uint32_t after = list.next[base + way];
+                list.next[base + before] = after;
+                list.prev[base + after] = before;
+                list.prev[base + way] = tail;
+                list.next[base + way] = head;
+                list.next[base + tail] = static_cast<uint32_t>(way);
+                list.prev[base + head] = static_cast<uint32_t>(way);
+            }
+            // The tail already sits right before the head of the circle
+            list.heads[set] = static_cast<uint32_t>(way);
+        }
+
+        /**
+         * @brief Append a free way to the tail of a set that is not full
+         *
+         * A packed set already has its free ways lined up behind its blocks.
+         * A wide set takes its first invalid way, scanning from way 0.
+         * @return the way
+         */
+        uint64_t appendFreeWay(uint64_t set)
+        {
+            if (sizes[set] == 0 && ++materialized == denseSets()) {
+                adviseHugePages();
+            }
+            if (packed()) {
+                return PackedOrder::wayAt(orderOf(set), sizes[set]++);
+            }
+            uint64_t base = set << geom.getS();
+            uint32_t way = static_cast<uint32_t>(
+                    store.valid.findClear(base, geom.getWays()));
+            if (sizes[set]++ == 0) {
+                list.heads[set] = way;
+                list.next[base + way] = way;
+                list.prev[base + way] = way;
+            } else {
+                uint32_t head = list.heads[set];
+                uint32_t tail = list.prev[base + head];
+                list.prev[base + way] = tail;
+                list.next[base + way] = head;
+                list.next[base + tail] = way;
+                list.prev[base + head] = way;
+            }
+            return way;
+        }
+
+        /**
+         * @brief Insert a block at the head, evicting the tail if set is full
+         * @return the evicted block, if any
+         */
+        block_result_t pushFront(block_t block)
+        {
+            uint64_t set = geom.index(blockAddress(block));
+            if (sizes[set] < geom.getWays()) { // have space in set, so no ejection
+                uint64_t way = appendFreeWay(set);
+                fill(set, way, block);
+                moveToFront(set, way);
+                return BLOCK_NONE;
+            } else { // have to evict the tail entry
+                uint64_t way = tailWay(set);
+                block_result_t tail = blockFound(blockAt(set, way));
+                fill(set, way, block);
+                moveToFront(set, way);
+                return tail;
+            }
+        }
+
+        /**
+         * @brief Insert a block at the tail, evicting the tail if set is full
+         * @return the evicted block, if any
+         */
+        block_result_t pushBack(block_t block)
+        {
+            uint64_t set = geom.index(blockAddress(block));
+            if (sizes[set] < geom.getWays()) { // have space in set, so no ejection
+                fill(set, appendFreeWay(set), block);
+                return BLOCK_NONE;
+            } else { // have to evict the tail entry
+                uint64_t way = tailWay(set);
+                block_result_t tail = blockFound(blockAt(set, way));
+                fill(set, way, block);
+                return tail;
+            }
+        }
+
+        /**
+         * @param ways_i the number of ways, normally 2^s_i
+         */
+        void initLevel(uint64_t c_i, uint64_t b_i, uint64_t s_i,
+                uint64_t ways_i)
+        {
+            geom.init(c_i, b_i, s_i, ways_i);
+            store.init(geom.getNumSets() << geom.getS());
+            sizes.assign(geom.getNumSets());
+            materialized = 0;
+            if (packed()) {
+                packedOrder.assign(geom.getNumSets());
+                list.clear();
+            } else {
+                packedOrder.clear();
+                list.init(geom.getNumSets(), geom.getNumSets() << geom.getS());
+            }
+            if (indexed()) {
+                tagIndex.init(geom.getNumSets(), geom.getWays());
+            } else {
+                tagIndex.clear();
+            }
+        }
+
+    public:
+        CacheLevel() : materialized(0)
+        {}
+
+        const G& geometry() const
+        {
+            return geom;
+        }
+
+        /**
+         * Number of sets that have held a block since init
+         */
+        uint64_t getMaterializedSets() const
+        {
+            return materialized;
+        }
+
+        /**
+         * Number of blocks resident in the set blockAddress maps to
+         */
+        uint64_t getSize(uint64_t blockAddress) const
+        {
+            return sizes[geom.index(blockAddress)];
+        }
+
+        /**
+         * Start of the tags of the set blockAddress maps to, for prefetching
+         */
+        const uint64_t *setTags(uint64_t blockAddress) const
+        {
+            return &store.tags[geom.index(blockAddress) << geom.getS()];
+        }
+
+        /**
+         * Finds a block, returns it if found without touching recency
+         */
+        block_result_t seek(uint64_t blockAddress) const
+        {
+            uint64_t set = geom.index(blockAddress);
+            uint64_t way = find(set, geom.tag(blockAddress));
+            if (way == geom.getWays()) {
+                return BLOCK_NONE;
+            } else {
+                return blockFound(blockAt(set, way));
+            }
+        }
+
+        /**
+         * Searches for a block, returns whether it is resident
+         */
+        bool contains(uint64_t blockAddress) const
+        {
+            uint64_t set = geom.index(blockAddress);
+            return find(set, geom.tag(blockAddress)) != geom.getWays();
+        }
+
+}; // CacheLevel
+
+/**
+ * @brief A set associative cache level with LRU policy
+ *
+ * LRU is the tail of each set's list (position size - 1)
+ * MRU is the head (position 0)
+ */
+template <class G>
+class LruCache : public CacheLevel<G>
+{
+    public:
+        void init(uint64_t c_i, uint64_t b_i, uint64_t s_i)
+        {
+            this->initLevel(c_i, b_i, s_i, 1UL << s_i);
+        }
+
+        /**
+         * @brief Insert a block in the LRU position, possibly evicting old LRU
+         *
+         * @param block the block to be inserted into LRU
+         * @return the evicted block, if any
+         */
+        block_result_t insertLru(block_t block)
+        {
+            return this->pushBack(block);
+        }
+
+        /**
+         * @brief Insert a block in the MRU position, possibly evicting old LRU
+         *
+         * @param block the block to be inserted into MRU
+         * @return the evicted block, if any
+         *
+         * NOTE: (!!!) Make sure value is not already in cache when inserting!!!
+         * can do read() (if L1 to try to access first) or seek() to see if in
+         * there already
+         */
+        block_result_t insertMru(block_t block)
+        {
+            return this->pushFront(block);
+        }
+
+        /**
+         * @brief Search for a block, moving it into MRU position if found
+         *
+         * A demand access uses up a prefetch, so the block stays in the set
+         * unflagged but is returned as it was found
+         */
+        block_result_t read(uint64_t blockAddress)
+        {
+            uint64_t set = this->geom.index(blockAddress);
+            uint64_t way = this->find(set, this->geom.tag(blockAddress));
+            if (way == this->geom.getWays()) { // block not found
+                return BLOCK_NONE;
+            } else {
+                block_t found = this->blockAt(set, way);
+                this->moveToFront(set, way);
+                this->store.prefetched.set((set << this->geom.getS()) + way,
+                        false);
+                return blockFound(found);
+            }
+        }
+
+        /**
+         * @brief Attempt to writeback to LRU set without setting RU order
+         *
+         * If a hit, mark block dirty and return it
+         * !!! DO NOT SET AS MRU IN L2!!!
+         */
+        block_result_t writeBackNoRU(uint64_t blockAddress)
+        {
+            uint64_t set = this->geom.index(blockAddress);
+            uint64_t way = this->find(set, this->geom.tag(blockAddress));
+            if (way == this->geom.getWays()) { // block not found
+                return BLOCK_NONE;
+            } else {
+                this->store.dirty.set((set << this->geom.getS()) + way, true);
+                return blockFound(this->blockAt(set, way));
+            }
+        }
+
+        /**
+         * @brief Attempt to writeback to LRU setting RU order
+         *
+         * If a hit, mark block dirty, make it MRU and return it
+         */
+        block_result_t writeBack(uint64_t blockAddress)
+        {
+            uint64_t set = this->geom.index(blockAddress);
+            uint64_t way = this->find(set, this->geom.tag(blockAddress));
+            if (way == this->geom.getWays()) { // block not found
+                return BLOCK_NONE;
+            } else {
+                this->store.dirty.set((set << this->geom.getS()) + way, true);
+                this->moveToFront(set, way);
+                return blockFound(this->blockAt(set, way));
+            }
+        }
+
+        /**
+         * @brief Mark the MRU block of a set dirty without searching the set
+         *
+         * Used when further writes hit the block that was just accessed,
+         * which is always the MRU block of its set
+         */
+        void markMruDirty(uint64_t blockAddress)
+        {
+            uint64_t set = this->geom.index(blockAddress);
+            this->store.dirty.set((set << this->geom.getS())
+                    + this->headWay(set), true);
+        }
+
+}; // LruCache
+
+/**
+ * @brief A fully associative victim cache
+ *
+ * This relies on a FIFO eviction policy, kept as a ring of block addresses
+ * whose size is v rounded up to a power of two. The newest block sits just
+ * below head and the oldest count slots below it; once v blocks are held,
+ * the oldest is evicted to make room.
+ *
+ * Any read that finds a matching block will also remove it and return it.
+ */
+class VictimCache
+{
+    private:
+        uint64_t v;
+
+        /**
+         * Block addresses and dirty bits of the ring slots, and which slots
+         * are in use
+         */
+        Slab<uint64_t> addrs;
+        SlotBits dirty;
+        SlotBits valid;
+
+        uint64_t slotMask;
+        uint64_t head;
+        uint64_t count;
+
+        /**
+         * Ring slot holding blockAddress, addrs.size() if there is none
+         *
+         * Every slot is compared at once, 64 at a time, and masked with the
+         * valid bits
+         */
+        uint64_t find(uint64_t blockAddress) const
+        {
+            for (uint64_t first = 0; first < addrs.size(); first += 64UL) {
+                uint64_t n = std::min(addrs.size() - first, 64UL);
+                uint64_t hits = MATCH_TAGS(&addrs[first], n, blockAddress)
+                    & valid.bits(first, n);
+                if (hits) {
+                    return first + static_cast<uint64_t>(__builtin_ctzl(hits));
+                }
+            }
+            return addrs.size();
+        }
+
+        /**
+         * Copy the entry in slot from over the one in slot to
+         */
+        void moveSlot(uint64_t from, uint64_t to)
+        {
+            addrs[to] = addrs[from];
+            dirty.set(to, dirty.test(from));
+        }
+
+    public:
+        VictimCache() : v(0), slotMask(0), head(0), count(0)
+        {}
+
+        /**
+         * Initialize, with new V parameter
+         *
+         * clog2(v) is the number of bits needed to represent desired number of
+         * VC blocks. With v = 0 there is no victim cache and every inserted
+         * block is handed straight back as the eviction.
+         */
+        void init(uint64_t v_i, uint64_t b_i)
+        {
+            // Holds exactly v blocks; only the ring is rounded up
+            uint64_t slots = v_i ? 1UL << clog2(v_i) : 0;
+            addrs.assign(slots);
+            dirty.assign(slots);
+            valid.assign(slots);
+            slotMask = slots - 1UL;
+            head = 0;
+            count = 0;
+            v = v_i;
+        }
+
+        uint64_t getSize() const { return count; }
+
+        /**
+         * Insert block into the victim cache
+         *
+         * @return the block that fell out of the FIFO, if any
+         */
+        block_result_t insert(block_t block)
+        {
+            if (addrs.empty()) { // nowhere to keep it, so it passes straight out
+                return blockFound(block);
+            }
+            block_result_t evicted = BLOCK_NONE;
+            if (count == v) { // full, so the oldest entry falls out
+                uint64_t oldest = (head - count) & slotMask;
+                evicted = blockFound(makeBlock(addrs[oldest],
+                            dirty.test(oldest)));
+                valid.set(oldest, false);
+            } else {
+                ++count;
+            }
+            addrs[head] = blockAddress(block);
+            dirty.set(head, isDirty(block));
+            valid.set(head, true);
+            head = (head + 1UL) & slotMask;
+            return evicted;
+        }
+
+        /**
+         * Finds a block, removes it from the victim cache and returns it
+         *
+         * The entries newer than the one removed move down a slot to close
+         * the gap, which keeps the ring contiguous and in FIFO order.
+         */
+        block_result_t retrieve(uint64_t blockAddress)
+        {
+            uint64_t slot = find(blockAddress);
+            if (slot == addrs.size()) {
+                return BLOCK_NONE;
+            }
+            block_t found = makeBlock(addrs[slot], dirty.test(slot));
+            uint64_t newest = (head - 1UL) & slotMask;
+            for (; slot != newest; slot = (slot + 1UL) & slotMask) {
+                moveSlot((slot + 1UL) & slotMask, slot);
+            }
+            valid.set(newest, false);
+            head = newest;
+            --count;
+            return blockFound(found);
+        }
+
+}; // VictimCache
+
+template <class G>
+class Prefetcher
+{
+    private:
+        /**
+         * Reference the L2 cache for prefetching ops
+         */
+        LruCache<G>& prefCache;
+
+        /**
+         * evictions buffer will hold blocks evicted by prefetch
+         *
+         * One prefetch evicts at most k blocks, so the buffer is sized once
+         * by init() and never grows; entries [nextEviction, numEvictions)
+         * are still to be popped
+         */
+        std::vector<block_t> evictions;
+        uint64_t numEvictions;
+        uint64_t nextEviction;
+
+        // The number of blocks to prefetch
+        uint64_t k;
+
+    public:
+        /**
+         * Constructor referencing to a cache
+         * Can be parameterized using init()
+         */
+        Prefetcher(LruCache<G>& prefCache_i)
+            : prefCache(prefCache_i), numEvictions(0), nextEviction(0), k(0)
+        {}
+
+        void init(uint64_t k_i)
+        {
+            k = k_i;
+            evictions.assign(k, makeBlock(0, false));
+            numEvictions = 0;
+            nextEviction = 0;
+        }
+
+        /**
+         * @brief prefetch K blocks into cache
+         *
+         * K blocks with increasing block addresses will be prefetched into cache.
+         * This may cause evictions from the cache, which will be stored in the
+         * evictions buffer
+         * Each time this runs, the evictions buffer is flushed
+         *
+         * @param startBlockAddress the block after which K of the following
+         * blocks will be fetched into the cache LRU values
+         * @return the number of blocks actually prefetched
+         */
+        uint64_t prefetch(uint64_t startBlockAddress)
+        {
+            uint64_t prefetched = 0;
+            numEvictions = 0;
+            nextEviction = 0;
+
+            for (auto i=1UL; i<=k; ++i) {
+                uint64_t prefBlockAddress = startBlockAddress + i;
+
+                // Check that set does not contain prefetched block
+                if(!prefCache.contains(prefBlockAddress)) {
+                    // A prefetched block cannot be dirty, and is flagged
+                    // to track prefetch utilization
+                    block_result_t evicted = prefCache.insertLru(
+                            makeBlock(prefBlockAddress, false, true));
+                    ++prefetched;
+                    if(evicted.found) {
+                        // If evictions occur, place them into evictions buffer
+                        evictions[numEvictions++] = evicted.block;
+                    }
+                }
+            }
+            return prefetched;
+        }
+
+        /**
+         * @brief pops eviction from evictions buffer
+         *
+         * Copies over and removes eviction from evictions buffer
+         */
+        block_t popEviction()
+        {
+            return evictions[nextEviction++];
+        }
+
+        bool isEmpty()
+        {
+            return (nextEviction == numEvictions);
+        }
+}; // Prefetcher
+
+/**
+ * Accesses per chunk of a batch whose block addresses are computed up front,
+ * and how many accesses ahead of use the L1/L2 sets are prefetched
+ */
+static const size_t BATCH_CHUNK = 256;
+static const size_t BATCH_PREFETCH_DISTANCE = 8;
+
+/**
+ * @brief A simulated cache hierarchy
+ *
+ * An engine holds all the state of one configuration, so several can be
+ * simulated side by side. All of that state is sized when the engine is
+ * created; simulating accesses never allocates.
+ */
+class CacheEngine
+{
+    public:
+        virtual ~CacheEngine()
+        {}
+
+        /**
+         * @brief Simulate one access, see cache_access()
+         */
+        virtual void access(uint64_t addr, char rw,
+                struct cache_stats_t *stats) = 0;
+
+        /**
+         * @brief Simulate runs of same-block accesses in trace order, see
+         * cache_access_runs()
+         *
+         * repeatReads and repeatWrites may be NULL for a plain batch
+         */
+        virtual void accessRuns(const uint64_t *addrs, const uint8_t *rw,
+                const uint32_t *repeatReads, const uint32_t *repeatWrites,
+                size_t n, struct cache_stats_t *stats) = 0;
+
+        /**
+         * @brief Start over with a new configuration, reusing this engine's
+         * memory
+         *
+         * Nothing is reallocated or reconstructed when the new levels fit in
+         * the old ones; state is cleared in bulk, so the cost follows what
+         * the previous run touched rather than the configured sizes.
+         *
+         * @return false, leaving the engine as it was, if its geometry is
+         * fixed and the configuration does not match it
+         */
+        virtual bool reset(const struct cache_config_t& conf) = 0;
+
+        /**
+         * @brief How much of the configured cache has been used, see
+         * cache_footprint()
+         */
+        virtual void footprint(struct cache_footprint_t *fp) const = 0;
+}; // CacheEngine
+
+/**
+ * @brief L1, victim cache and L2 with the given level geometries
+ */
+template <class L1G, class L2G>
+class Engine : public CacheEngine
+{
+    private:
+        LruCache<L1G> l1;
+        LruCache<L2G> l2;
+        VictimCache vc;
+        Prefetcher<L2G> l2Prefetch;
+
+        /**
+         * @brief procedure to insert block from L2 into L1
+         *
+         * L1, L2, and the Victim Cache are affected.
+         *
+         * @return nothing found if everything was a success, the block
+         * evicted to memory if that occurred
+         */
+        block_result_t insertL1FromL2(block_t l2Block)
+        {
+            block_result_t l1Evicted = l1.insertMru(l2Block);
+
+            if(!l1Evicted.found) { // nothing evicted from L1; improbable
+                return BLOCK_NONE;
+            }
+
+            block_result_t vcEvicted = vc.insert(l1Evicted.block);
+
+            if(!vcEvicted.found) { // nothing evicted from vc; improbable
+                return BLOCK_NONE;
+            }
+
+            if(!isDirty(vcEvicted.block)) { // if clean entry evicted from VC, can discard
+                return BLOCK_NONE;
+            } else { // Dirty, so need to update L2 writeback accordingly
+                // Writeback returns written block if found
+                block_result_t l2Writeback
+                    = l2.writeBackNoRU(blockAddress(vcEvicted.block));
+                // If found, then successfully wrote a dirty bit, nothing to evict
+                if (l2Writeback.found) return BLOCK_NONE;
+
+                // If did not find that block in L2 set, then insert it
+                // Return block evicted from L2
+                return l2.insertLru(vcEvicted.block);
+            }
+        }
+
+        /**
+         * @brief Write a block evicted from L2 back to memory if it is dirty
+         */
+        void writeBackToMemory(block_result_t evicted,
+                struct cache_stats_t *stats)
+        {
+            if (evicted.found && isDirty(evicted.block)) {
+                stats->num_write_backs++;
+                stats->num_bytes_transferred += 1UL << l1.geometry().getB();
+            }
+        }
+
+        void accessOne(uint64_t addr, char rw, struct cache_stats_t *stats)
+        {
+            bool isWrite = (rw == WRITE);
+
+            stats->num_accesses++;
+            if(isWrite) {
+                stats->num_accesses_writes++;
+            } else {
+                stats->num_accesses_reads++;
+            }
+
+            uint64_t blockAddress = addr >> l1.geometry().getB();
+
+            block_result_t l1Hit;
+            if (isWrite) {
+                l1Hit = l1.writeBack(blockAddress);
+            } else {
+                l1Hit = l1.read(blockAddress);
+            }
+
+            if (l1Hit.found) {
+                return;
+            }
+
+            stats->num_misses_l1++;
+            if(isWrite) {
+                stats->num_misses_writes_l1++;
+            } else {
+                stats->num_misses_reads_l1++;
+            }
+
+            // Check the victim cache before going to L2
+            block_result_t vcHit = vc.retrieve(blockAddress);
+            if (vcHit.found) {
+                stats->num_hits_vc++;
+
+                // Swap the found block with the L1 victim. The victim cache
+                // just gave up a block, so the victim always fits.
+                block_result_t l1Evicted = l1.insertMru(makeBlock(blockAddress,
+                            isDirty(vcHit.block) || isWrite));
+                if (l1Evicted.found) {
+                    vc.insert(l1Evicted.block);
+                }
+                return;
+            }
+
+            stats->num_misses_vc++;
+            if(isWrite) {
+                stats->num_misses_writes_vc++;
+            } else {
+                stats->num_misses_reads_vc++;
+            }
+
+            // Writes only dirty the top level, so L2 always holds the clean
+            // block
+            block_result_t l2Hit = l2.read(blockAddress);
+            if (!l2Hit.found) {
+                stats->num_misses_l2++;
+                if(isWrite) {
+                    stats->num_misses_writes_l2++;
+                } else {
+                    stats->num_misses_reads_l2++;
+                }
+
+                // Fetch the block from memory into L2
+                stats->num_bytes_transferred += 1UL << l1.geometry().getB();
+                writeBackToMemory(l2.insertMru(makeBlock(blockAddress, false)),
+                        stats);
+            } else if (isPrefetched(l2Hit.block)) {
+                stats->num_useful_prefetches++;
+            }
+
+            // Then into L1, which may push blocks down through VC and L2
+            writeBackToMemory(insertL1FromL2(makeBlock(blockAddress, isWrite)),
+                    stats);
+
+            // Prefetch only after the demand miss is fully installed
+            if (!l2Hit.found) {
+                uint64_t prefetched = l2Prefetch.prefetch(blockAddress);
+                stats->num_prefetches += prefetched;
+                stats->num_bytes_transferred
+                    += prefetched << l1.geometry().getB();
+                while (!l2Prefetch.isEmpty()) {
+                    writeBackToMemory(blockFound(l2Prefetch.popEviction()),
+                            stats);
+                }
+            }
+        }
+
+        /**
+         * @brief Account for accesses that repeat the block accessed just
+         * before
+         *
+         * Every access leaves its block in the MRU position of its L1 set, so
+         * repeats are L1 hits that only bump the access counters and, for
+         * writes, set the dirty bit. Recency order is unchanged. This is O(1)
+         * regardless of the number of repeats.
+         */
+        void applyRepeats(uint64_t blockAddress, uint64_t reads,
+                uint64_t writes, struct cache_stats_t *stats)
+        {
+            stats->num_accesses += reads + writes;
+            stats->num_accesses_reads += reads;
+            stats->num_accesses_writes += writes;
+
+            if (writes) {
+                l1.markMruDirty(blockAddress);
+            }
+        }
+
+    public:
+        explicit Engine(const struct cache_config_t& conf) : l2Prefetch(l2)
+        {
+            reset(conf);
+        }
+
+        virtual bool reset(const struct cache_config_t& conf)
+        {
+            if (!l1.geometry().fits(conf.c, conf.b, conf.s)
+                    || !l2.geometry().fits(conf.C, conf.b, conf.S)) {
+                return false;
+            }
+            l1.init(conf.c, conf.b, conf.s);
+            l2.init(conf.C, conf.b, conf.S);
+            vc.init(conf.v, conf.b);
+            l2Prefetch.init(conf.k);
+            return true;
+        }
+
+        virtual void access(uint64_t addr, char rw,
+                struct cache_stats_t *stats)
+        {
+            accessOne(addr, rw, stats);
+        }
+
+        virtual void footprint(struct cache_footprint_t *fp) const
+        {
+            fp->sets_l1 = l1.geometry().getNumSets();
+            fp->sets_materialized_l1 = l1.getMaterializedSets();
+            fp->sets_l2 = l2.geometry().getNumSets();
+            fp->sets_materialized_l2 = l2.getMaterializedSets();
+        }
+
+        /**
+         * The block addresses of a chunk are computed first so each L1 and
+         * L2 set can be prefetched a few accesses before it is looked up,
+         * hiding the memory latency of large tag stores.
+         */
+        virtual void accessRuns(const uint64_t *addrs, const uint8_t *rw,
+                const uint32_t *repeatReads, const uint32_t *repeatWrites,
+                size_t n, struct cache_stats_t *stats)
+        {
+            uint64_t blocks[BATCH_CHUNK];
+
+            for (size_t base = 0; base < n; base += BATCH_CHUNK) {
+                size_t count = std::min(BATCH_CHUNK, n - base);
+
+                for (size_t i = 0; i < count; ++i) {
+                    blocks[i] = addrs[base + i] >> l1.geometry().getB();
+                }
+
+                for (size_t i = 0;
+                        i < std::min(BATCH_PREFETCH_DISTANCE, count); ++i) {
+                    __builtin_prefetch(l1.setTags(blocks[i]));
+                    __builtin_prefetch(l2.setTags(blocks[i]));
+                }
+
+                for (size_t i = 0; i < count; ++i) {
+                    if (i + BATCH_PREFETCH_DISTANCE < count) {
+                        size_t ahead = i + BATCH_PREFETCH_DISTANCE;
+                        __builtin_prefetch(l1.setTags(blocks[ahead]));
+                        __builtin_prefetch(l2.setTags(blocks[ahead]));
+                    }
+                    accessOne(addrs[base + i], rw[base + i] ? WRITE : READ,
+                            stats);
+                    if (repeatReads) {
+                        applyRepeats(blocks[i], repeatReads[base + i],
+                                repeatWrites[base + i], stats);
+                    }
+                }
+            }
+        }
+}; // Engine
+
+/**
+ * @brief Creates engines of one type
+ */
+typedef CacheEngine *(*CacheEngineFactory)(const struct cache_config_t& conf);
+
+/**
+ * @brief Look up the engine type for a configuration in the dispatch table
+ *
+ * Configurations in the dispatch table get an engine with compile-time
+ * geometry, everything else the generic one.
+ *
+ * @return the factory of that engine type
+ */
+CacheEngineFactory findCacheEngine(const struct cache_config_t& conf);
+
+/**
+ * @brief An engine that is kept across configurations
+ *
+ * init() resets the current engine in place only if the dispatch table
+ * picks the same engine type for the new configuration. Otherwise it is
+ * replaced, so a generic engine left over from an earlier configuration
+ * never stands in for a specialized one.
+ */
+class EngineSlot
+{
+    private:
+        std::unique_ptr<CacheEngine> engine;
+        CacheEngineFactory factory;
+
+    public:
+        EngineSlot() : factory(NULL)
+        {}
+
+        void init(const struct cache_config_t& conf)
+        {
+            CacheEngineFactory wanted = findCacheEngine(conf);
+            if (!engine || wanted != factory || !engine->reset(conf)) {
+                engine.reset(wanted(conf));
+                factory = wanted;
+            }
+        }
+
+        CacheEngine *operator->() const
+        {
+            return engine.get();
+        }
+}; // EngineSlot
+
+/**
+ * @brief Several configurations advanced through the same accesses together
+ *
+ * Every batch is handed to each engine in turn, so the trace is decoded
+ * once for all of them and each engine's state stays hot in the host
+ * caches for a whole batch. Each engine keeps its own levels in its own
+ * slabs. Later init() calls reset engines in place where the dispatch table
+ * picks the same engine type, see EngineSlot.
+ */
+class LockstepEngine
+{
+    private:
+        std::vector<EngineSlot> engines;
+
+    public:
+        void init(const struct cache_config_t *confs, size_t n)
+        {
+            engines.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                engines[i].init(confs[i]);
+            }
+        }
+
+        size_t size() const
+        {
+            return engines.size();
+        }
+
+        /**
+         * @brief Simulate runs for every configuration, see
+         * cache_access_runs()
+         *
+         * Runs must not span blocks of any configuration; runs cut at the
+         * smallest block size of all of them work for every one.
+         *
+         * @param stats one per configuration
+         */
+        void accessRuns(const uint64_t *addrs, const uint8_t *rw,
+                const uint32_t *repeatReads, const uint32_t *repeatWrites,
+                size_t n, struct cache_stats_t *stats)
+        {
+            for (size_t i = 0; i < engines.size(); ++i) {
+                engines[i]->accessRuns(addrs, rw, repeatReads, repeatWrites,
+                        n, &stats[i]);
+            }
+        }
+
+        void footprint(size_t i, struct cache_footprint_t *fp) const
+        {
+            engines[i]->footprint(fp);
+        }
+}; // LockstepEngine
+
+#endif // CACHE_ENGINE_H
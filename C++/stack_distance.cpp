@@ -0,0 +1,107 @@
+/**
+ * @file stack_distance.cpp
+ * @brief Single-pass L1 miss counts for many associativities at once
+ */
+
+#include "stack_distance.hpp"
+
+#include <algorithm>
+
+StackProfile::StackProfile() : maxS(0), accesses(0)
+{}
+
+void StackProfile::init(uint64_t indexBits, uint64_t b_i, uint64_t maxS_i)
+{
+    maxS = maxS_i;
+    accesses = 0;
+    hits.assign(maxS + 1, 0UL);
+    initLevel(indexBits + maxS + b_i, b_i, maxS, 1UL << maxS);
+}
+
+void StackProfile::accessBlock(uint64_t blockAddress)
+{
+    ++accesses;
+    uint64_t set = geom.index(blockAddress);
+    uint64_t way = find(set, geom.tag(blockAddress));
+    if (way == geom.getWays()) { // deeper than any profiled set, or cold
+        pushFront(makeBlock(blockAddress, false));
+        return;
+    }
+
+    uint64_t distance = position(set, way);
+    ++hits[distance ? 64 - static_cast<uint64_t>(__builtin_clzl(distance)) : 0];
+    moveToFront(set, way);
+}
+
+void StackProfile::accessRuns(const uint64_t *addrs,
+        const uint32_t *repeatReads, const uint32_t *repeatWrites, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        accessBlock(addrs[i] >> geom.getB());
+
+        // Repeats find their block at the top of the stack
+        uint64_t repeats = static_cast<uint64_t>(repeatReads[i])
+            + repeatWrites[i];
+        accesses += repeats;
+        hits[0] += repeats;
+    }
+}
+
+uint64_t StackProfile::getMisses(uint64_t s) const
+{
+    uint64_t misses = accesses;
+    for (uint64_t j = 0; j <= s; ++j) {
+        misses -= hits[j];
+    }
+    return misses;
+}
+
+AllAssocProfile::AllAssocProfile()
+    : b(0), minC(0), maxC(0), maxS(0), minIndexBits(0)
+{}
+
+void AllAssocProfile::init(uint64_t b_i, uint64_t minC_i, uint64_t maxC_i,
+        uint64_t maxS_i)
+{
+    b = b_i;
+    minC = minC_i;
+    maxC = maxC_i;
+    maxS = maxS_i;
+    minIndexBits = minC > maxS + b ? minC - maxS - b : 0;
+
+    // A profile is reused as long as its set count is still needed
+    uint64_t count = maxC >= b + minIndexBits ? maxC - b - minIndexBits + 1 : 0;
+    profiles.resize(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t indexBits = minIndexBits + i;
+        if (!profiles[i]) {
+            profiles[i].reset(new StackProfile);
+        }
+        profiles[i]->init(indexBits, b,
+                std::min(maxS, maxC - b - indexBits));
+    }
+}
+
+void AllAssocProfile::accessRuns(const uint64_t *addrs,
+        const uint32_t *repeatReads, const uint32_t *repeatWrites, size_t n)
+{
+    // Whole batches per profile keep each profile's sets in cache
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        profiles[i]->accessRuns(addrs, repeatReads, repeatWrites, n);
+    }
+}
+
+uint64_t AllAssocProfile::getAccesses() const
+{
+    return profiles.empty() ? 0 : profiles[0]->getAccesses();
+}
+
+bool AllAssocProfile::covers(uint64_t c, uint64_t s) const
+{
+    return c >= minC && c <= maxC && s <= maxS && c >= s + b + minIndexBits;
+}
+
+uint64_t AllAssocProfile::getMisses(uint64_t c, uint64_t s) const
+{
+    return profiles[c - s - b - minIndexBits]->getMisses(s);
+}
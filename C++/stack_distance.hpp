@@ -0,0 +1,127 @@
+/**
+ * @file stack_distance.hpp
+ * @brief Single-pass L1 miss counts for many associativities at once
+ *
+ * With the number of sets fixed, an LRU set of 2^s ways always holds the
+ * 2^s most recently used blocks of that set, so it also holds everything a
+ * set of fewer ways would (the inclusion property). An access hits in a
+ * 2^s way set exactly when its LRU stack distance, the number of distinct
+ * blocks of its set used since its last access, is below 2^s. Recording
+ * stack distances once therefore gives the miss count of every s.
+ *
+ * Varying the number of sets as well takes one such profile per set count,
+ * all fed from the same pass over the trace.
+ */
+
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "cache.hpp"
+#include "cache_engine.hpp"
+
+/**
+ * @brief Largest s a StackProfile tracks
+ */
+static const uint64_t STACK_PROFILE_MAX_S = 16;
+
+/**
+ * @brief LRU stack distances of an L1 with a fixed number of sets
+ *
+ * One LRU stack of 2^maxS ways is kept per set. Misses in the L1 depend on
+ * nothing but its own LRU order: victim cache hits are still L1 misses and
+ * the prefetcher only fills L2. Hits of the profile are binned by the
+ * smallest s whose set would hold them.
+ */
+class StackProfile : private CacheLevel<DynamicGeometry>
+{
+    private:
+        uint64_t maxS;
+        uint64_t accesses;
+
+        /**
+         * hits[j] counts accesses at stack distance 0 for j = 0, and in
+         * [2^(j-1), 2^j) for j > 0
+         */
+        std::vector<uint64_t> hits;
+
+        void accessBlock(uint64_t blockAddress);
+
+    public:
+        StackProfile();
+
+        /**
+         * @brief Profile 2^indexBits sets of 2^b byte blocks, for
+         * associativities 2^0 through 2^maxS_i
+         */
+        void init(uint64_t indexBits, uint64_t b_i, uint64_t maxS_i);
+
+        /**
+         * @brief Profile runs of same-block accesses in trace order, see
+         * cache_access_runs()
+         */
+        void accessRuns(const uint64_t *addrs, const uint32_t *repeatReads,
+                const uint32_t *repeatWrites, size_t n);
+
+        uint64_t getMaxS() const { return maxS; }
+        uint64_t getAccesses() const { return accesses; }
+
+        /**
+         * L1 misses with 2^s ways per set, for s <= getMaxS()
+         */
+        uint64_t getMisses(uint64_t s) const;
+}; // StackProfile
+
+/**
+ * @brief L1 misses for every (c, s) in a range, at a fixed block size
+ *
+ * Keeps a StackProfile for every number of sets the range needs, each only
+ * as deep as the largest s it is asked about.
+ */
+class AllAssocProfile
+{
+    private:
+        uint64_t b;
+        uint64_t minC, maxC, maxS;
+        uint64_t minIndexBits;
+
+        /**
+         * profiles[i] has 2^(minIndexBits + i) sets
+         */
+        std::vector<std::unique_ptr<StackProfile> > profiles;
+
+    public:
+        AllAssocProfile();
+
+        /**
+         * @brief Profile every c in [minC_i, maxC_i] and s in [0, maxS_i]
+         * with c >= s + b_i
+         */
+        void init(uint64_t b_i, uint64_t minC_i, uint64_t maxC_i,
+                uint64_t maxS_i);
+
+        /**
+         * @brief Profile runs of same-block accesses in trace order, see
+         * cache_access_runs()
+         */
+        void accessRuns(const uint64_t *addrs, const uint32_t *repeatReads,
+                const uint32_t *repeatWrites, size_t n);
+
+        uint64_t getAccesses() const;
+
+        /**
+         * Whether (c, s) is in the profiled range
+         */
+        bool covers(uint64_t c, uint64_t s) const;
+
+        /**
+         * L1 misses of a 2^c byte L1 with 2^s ways per set, if covers(c, s)
+         */
+        uint64_t getMisses(uint64_t c, uint64_t s) const;
+}; // AllAssocProfile
+
+#endif // STACK_DISTANCE_H
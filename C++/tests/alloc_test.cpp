@@ -0,0 +1,177 @@
+/**
+ * @file alloc_test.cpp
+ * @brief Checks that simulating accesses never allocates
+ *
+ * Usage: ./alloc-test <trace>...
+ *
+ * cache_init() sizes every structure up front; from then on the access
+ * paths must run without touching the heap. Global operator new is replaced
+ * with one that counts calls while a simulation is running.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "cache.hpp"
+#include "trace.hpp"
+#include "test_util.hpp"
+
+static bool counting = false;
+static uint64_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    if (counting) {
+        ++allocations;
+    }
+    void *p = std::malloc(size ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void *p) noexcept
+{
+    operator delete(p);
+}
+
+/**
+ * @brief Run the whole trace through every access entry point
+ *
+ * The trace is handed out in runs by the TraceBuffer. One access at a
+ * time, a run is replayed as its first access and then its repeats, and
+ * cache_access_batch() gets the first access of each run.
+ *
+ * @return the allocations made while accesses were simulated
+ */
+static uint64_t count_allocations(const TraceBuffer& buffer,
+        cache_config_t conf, trace_batch_t *batch)
+{
+    cache_stats_t stats = cache_stats_t();
+    allocations = 0;
+
+    // One access at a time
+    cache_init(&conf);
+    size_t cursor = 0;
+    while (buffer.fillRuns(&cursor, conf.b, batch)) {
+        counting = true;
+        for (size_t i = 0; i < batch->n; ++i) {
+            cache_access(batch->addr[i], batch->write[i] ? WRITE : READ,
+                    &stats);
+            for (uint32_t r = 0; r < batch->repeat_reads[i]; ++r) {
+                cache_access(batch->addr[i], READ, &stats);
+            }
+            for (uint32_t w = 0; w < batch->repeat_writes[i]; ++w) {
+                cache_access(batch->addr[i], WRITE, &stats);
+            }
+        }
+        counting = false;
+    }
+    cache_cleanup(&stats);
+
+    // Batches of accesses, then runs of same-block accesses
+    stats = cache_stats_t();
+    cache_init(&conf);
+    cursor = 0;
+    while (buffer.fillRuns(&cursor, conf.b, batch)) {
+        counting = true;
+        cache_access_batch(batch->addr, batch->write, batch->n, &stats);
+        counting = false;
+    }
+    cache_cleanup(&stats);
+
+    stats = cache_stats_t();
+    cache_init(&conf);
+    counting = true;
+    cursor = 0;
+    while (buffer.fillRuns(&cursor, conf.b, batch)) {
+        cache_access_runs(batch->addr, batch->write, batch->repeat_reads,
+                batch->repeat_writes, batch->n, &stats);
+    }
+    counting = false;
+    cache_cleanup(&stats);
+
+    return allocations;
+}
+
+/**
+ * @brief Run the whole trace through every configuration in lockstep
+ * @return the allocations made while accesses were simulated
+ */
+static uint64_t count_lockstep_allocations(const TraceBuffer& buffer,
+        const std::vector<cache_config_t>& confs, trace_batch_t *batch)
+{
+    uint64_t minB = confs[0].b;
+    for (size_t i = 1; i < confs.size(); ++i) {
+        minB = std::min(minB, confs[i].b);
+    }
+
+    std::vector<cache_stats_t> stats(confs.size(), cache_stats_t());
+    allocations = 0;
+
+    cache_init_lockstep(confs.data(), confs.size());
+    counting = true;
+    size_t cursor = 0;
+    while (buffer.fillRuns(&cursor, minB, batch)) {
+        cache_access_runs_lockstep(batch->addr, batch->write,
+                batch->repeat_reads, batch->repeat_writes, batch->n,
+                stats.data());
+    }
+    counting = false;
+    cache_cleanup_lockstep(stats.data());
+
+    return allocations;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cout << "./alloc-test <trace>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<cache_config_t> confs = test_configs();
+    std::unique_ptr<trace_batch_t> batch(new trace_batch_t);
+    bool ok = true;
+
+    for (int i = 1; i < argc; ++i) {
+        TraceReader reader(argv[i]);
+        TraceBuffer buffer(reader);
+
+        for (size_t j = 0; j < confs.size(); ++j) {
+            uint64_t n = count_allocations(buffer, confs[j], batch.get());
+            if (n != 0) {
+                std::cout << argv[i] << ": " << confs[j] << ": " << n
+                          << " allocations while simulating" << std::endl;
+                ok = false;
+            }
+        }
+
+        uint64_t n = count_lockstep_allocations(buffer, confs, batch.get());
+        if (n != 0) {
+            std::cout << argv[i] << ": " << n
+                      << " allocations while simulating in lockstep"
+                      << std::endl;
+            ok = false;
+        }
+        std::cout << argv[i] << ": " << buffer.size()
+                  << " accesses, " << (confs.size() + 1) << " runs checked"
+                  << std::endl;
+    }
+
+    return ok ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file delta_codec_test.cpp
+ * @brief Checks that converting traces between formats keeps every access
+ *
+ * Usage: ./delta-codec-test <cachesim-convert> <trace>...
+ *
+ * Each text trace, and a generated one with addresses at the edges of all
+ * four delta streams and deltas spanning most of the address space, is
+ * converted to a packed trace and that in turn to a delta trace with
+ * cachesim-convert. All three must decode to the same accesses, up to bit 0
+ * of the address, which binary records use for the R/W flag.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "trace.hpp"
+#include "test_util.hpp"
+
+/**
+ * Stream boundaries, the vsyscall page above the stack, and jumps between
+ * the lowest and highest addresses of one stream in both directions
+ */
+static const uint64_t EDGE_ADDRS[] = {
+    0x0UL, 0xfffffeUL, 0x400000UL, 0x0UL,
+    0x1000000UL, 0x7effffffffffUL, 0x1000000UL, 0x1a2b3c4UL,
+    0x7f0000000000UL, 0x7fefffffffffUL, 0x7f0000000000UL, 0x7f1234567890UL,
+    0x7ff000000000UL, 0xfffffffffffffffeUL, 0x7ff000000000UL,
+    0x7ffffffde000UL, 0xffffffffff600100UL, 0x7ffffffde008UL,
+    0xffffffffff6001f8UL, 0x7ffffffde010UL,
+    0xffffffffffffffffUL, 0x0UL, 0x7fffffffffffffffUL, 0x8000000000000000UL,
+    0x1000000UL, 0xfffffffUL, 0x7f0000000000UL, 0x400001UL,
+};
+
+static std::string edge_trace()
+{
+    std::string text;
+    char line[32];
+    for (size_t i = 0; i < sizeof(EDGE_ADDRS) / sizeof(EDGE_ADDRS[0]); ++i) {
+        snprintf(line, sizeof(line), "0x%llx %c\n",
+                static_cast<unsigned long long>(EDGE_ADDRS[i]),
+                i % 3 ? READ : WRITE);
+        text += line;
+    }
+    return text;
+}
+
+static std::vector<test_access_t> decode(const std::string& path)
+{
+    TraceReader reader(path.c_str());
+    return read_accesses(reader);
+}
+
+static bool check_trace(const char *converter, const std::string& path,
+        const std::string& name)
+{
+    std::vector<test_access_t> want = decode(path);
+    for (test_access_t& access : want) {
+        access.addr &= ~TRACE_RW_BIT;
+    }
+
+    std::string packed = write_temp_file("");
+    std::string delta = write_temp_file("");
+    bool ok = convert_trace(converter, path, packed, false)
+        && same_accesses(decode(packed), want, name + ": packed")
+        && convert_trace(converter, packed, delta, true)
+        && same_accesses(decode(delta), want, name + ": delta");
+    std::remove(packed.c_str());
+    std::remove(delta.c_str());
+
+    std::cout << name << ": " << want.size() << " accesses checked"
+              << std::endl;
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cout << "./delta-codec-test <cachesim-convert> <trace>..."
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string edgePath = write_temp_file(edge_trace());
+    bool ok = check_trace(argv[1], edgePath, "edge cases");
+    std::remove(edgePath.c_str());
+
+    for (int i = 2; i < argc; ++i) {
+        ok = check_trace(argv[1], argv[i], argv[i]) && ok;
+    }
+    return ok ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file lockstep_test.cpp
+ * @brief Checks that simulating configurations in lockstep changes nothing
+ *
+ * Usage: ./lockstep-test <trace>...
+ *
+ * Every configuration is run over each trace in one lockstep pass, with
+ * runs cut at the smallest block size of them all, and must end up with the
+ * statistics it gets when simulated on its own.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "cache.hpp"
+#include "trace.hpp"
+#include "test_util.hpp"
+
+static std::vector<cache_stats_t> simulate_lockstep(const char *path,
+        const std::vector<cache_config_t>& confs, trace_batch_t *batch)
+{
+    uint64_t minB = confs[0].b;
+    for (size_t i = 1; i < confs.size(); ++i) {
+        minB = std::min(minB, confs[i].b);
+    }
+
+    std::vector<cache_stats_t> stats(confs.size(), cache_stats_t());
+    cache_init_lockstep(confs.data(), confs.size());
+    TraceReader reader(path);
+    size_t n;
+    while ((n = reader.readRuns(batch->addr, batch->write,
+                    batch->repeat_reads, batch->repeat_writes,
+                    TRACE_BATCH_SIZE, minB))) {
+        cache_access_runs_lockstep(batch->addr, batch->write,
+                batch->repeat_reads, batch->repeat_writes, n, stats.data());
+    }
+    cache_cleanup_lockstep(stats.data());
+    return stats;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cout << "./lockstep-test <trace>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<cache_config_t> confs = test_configs();
+    std::unique_ptr<trace_batch_t> batch(new trace_batch_t);
+    bool ok = true;
+
+    for (int i = 1; i < argc; ++i) {
+        std::vector<cache_stats_t> got = simulate_lockstep(argv[i], confs,
+                batch.get());
+        for (size_t j = 0; j < confs.size(); ++j) {
+            std::ostringstream what;
+            what << argv[i] << ": " << confs[j] << ": lockstep";
+            ok = same_stats(got[j], simulate_accesses(argv[i], confs[j]),
+                    what.str()) && ok;
+        }
+        std::cout << argv[i] << ": " << confs.size()
+                  << " configurations checked" << std::endl;
+    }
+    return ok ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,453 @@
+/**
+ * @file lru_cache_test.cpp
+ * @brief Checks LruCache against the std::list sets it replaced
+ *
+ * Usage: ./lru-cache-test <trace>...
+ *
+ * The reference keeps every set as a linked list, MRU at the front, with
+ * the semantics of the original LruSet: read() moves a block to the front
+ * and uses up its prefetch, writeBack() dirties and moves it, and
+ * writeBackNoRU() dirties it in place. Both caches get the same calls and
+ * must return the same blocks, evict the same blocks and hold the same
+ * blocks afterwards.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cache.hpp"
+#include "cache_engine.hpp"
+#include "trace.hpp"
+#include "test_util.hpp"
+
+class ListLruCache
+{
+    private:
+        typedef std::list<block_t> Set;
+
+        uint64_t ways;
+        uint64_t indexBits;
+        std::vector<Set> sets;
+
+        /**
+         * Where each resident block sits in its set, so that wide sets are
+         * not searched
+         */
+        std::unordered_map<uint64_t, Set::iterator> where;
+
+        Set& setOf(uint64_t address)
+        {
+            return sets[address & ((1UL << indexBits) - 1UL)];
+        }
+
+        void pushFront(Set& set, block_t block)
+        {
+            set.push_front(block);
+            where[blockAddress(block)] = set.begin();
+        }
+
+        void pushBack(Set& set, block_t block)
+        {
+            set.push_back(block);
+            where[blockAddress(block)] = --set.end();
+        }
+
+        block_t popBack(Set& set)
+        {
+            block_t lru = set.back();
+            where.erase(blockAddress(lru));
+            set.pop_back();
+            return lru;
+        }
+
+        /**
+         * Remove a resident block from its set and return it
+         */
+        bool take(uint64_t address, block_t *block)
+        {
+            std::unordered_map<uint64_t, Set::iterator>::iterator it
+                = where.find(address);
+            if (it == where.end()) {
+                return false;
+            }
+            *block = *it->second;
+            setOf(address).erase(it->second);
+            where.erase(it);
+            return true;
+        }
+
+    public:
+        ListLruCache(uint64_t c, uint64_t b, uint64_t s, uint64_t ways_i)
+            : ways(ways_i), indexBits(c - s - b), sets(1UL << indexBits)
+        {}
+
+        const Set& contents(uint64_t address)
+        {
+            return setOf(address);
+        }
+
+        block_result_t insertLru(block_t block)
+        {
+            Set& set = setOf(blockAddress(block));
+            block_result_t evicted = BLOCK_NONE;
+            if (set.size() == ways) {
+                evicted = blockFound(popBack(set));
+            }
+            pushBack(set, block);
+            return evicted;
+        }
+
+        block_result_t insertMru(block_t block)
+        {
+            Set& set = setOf(blockAddress(block));
+            block_result_t evicted = BLOCK_NONE;
+            if (set.size() == ways) {
+                evicted = blockFound(popBack(set));
+            }
+            pushFront(set, block);
+            return evicted;
+        }
+
+        block_result_t read(uint64_t address)
+        {
+            block_t found;
+            if (!take(address, &found)) {
+                return BLOCK_NONE;
+            }
+            pushFront(setOf(address), makeBlock(address, isDirty(found)));
+            return blockFound(found);
+        }
+
+        block_result_t writeBackNoRU(uint64_t address)
+        {
+            std::unordered_map<uint64_t, Set::iterator>::iterator it
+                = where.find(address);
+            if (it == where.end()) {
+                return BLOCK_NONE;
+            }
+            it->second->flags |= BLOCK_DIRTY;
+            return blockFound(*it->second);
+        }
+
+        block_result_t writeBack(uint64_t address)
+        {
+            block_t found;
+            if (!take(address, &found)) {
+                return BLOCK_NONE;
+            }
+            found.flags |= BLOCK_DIRTY;
+            pushFront(setOf(address), found);
+            return blockFound(found);
+        }
+};
+
+/**
+ * @brief An LruCache whose sets may have fewer ways than 2^s
+ */
+template <class G>
+class WaysLruCache : public LruCache<G>
+{
+    public:
+        void init(uint64_t c_i, uint64_t b_i, uint64_t s_i, uint64_t ways_i)
+        {
+            this->initLevel(c_i, b_i, s_i, ways_i);
+        }
+};
+
+/**
+ * @brief Home bucket of tag in the TagIndex of a set with ways ways
+ */
+static uint64_t home_bucket(uint64_t tag, uint64_t ways)
+{
+    return (tag * 0x9e3779b97f4a7c15UL) >> (64 - (clog2(ways) + 1));
+}
+
+/**
+ * Accesses of each trace to run through every geometry
+ */
+static const uint64_t TRACE_ACCESSES = 200000;
+
+/**
+ * @brief Calls between comparisons of a whole set, so that comparing wide
+ * sets does not dominate the run time
+ */
+static uint64_t same_set_interval(uint64_t ways)
+{
+    return std::max(64UL, ways);
+}
+
+static bool same_result(block_result_t a, block_result_t b)
+{
+    return a.found == b.found && (!a.found
+            || (a.block.address == b.block.address
+                && a.block.flags == b.block.flags));
+}
+
+/**
+ * @brief Drives a cache under test and the reference with the same calls
+ */
+template <class Cache>
+class LruChecker
+{
+    private:
+        Cache& cache;
+        ListLruCache ref;
+        std::string name;
+        uint64_t calls;
+
+        bool check(block_result_t got, block_result_t expected,
+                const char *op, uint64_t address)
+        {
+            ++calls;
+            if (same_result(got, expected)) {
+                return true;
+            }
+            std::cout << name << ": " << op << " of block " << address
+                      << " (call " << calls << ") returned "
+                      << (got.found ? "" : "nothing ") << got.block.address
+                      << "/" << got.block.flags << ", expected "
+                      << (expected.found ? "" : "nothing ")
+                      << expected.block.address << "/"
+                      << expected.block.flags << std::endl;
+            return false;
+        }
+
+    public:
+        LruChecker(Cache& cache_i, uint64_t c, uint64_t b, uint64_t s,
+                uint64_t ways, const std::string& name_i)
+            : cache(cache_i), ref(c, b, s, ways), name(name_i), calls(0)
+        {}
+
+        bool read(uint64_t address, block_result_t *result)
+        {
+            *result = ref.read(address);
+            return check(cache.read(address), *result, "read", address);
+        }
+
+        bool writeBack(uint64_t address, block_result_t *result)
+        {
+            *result = ref.writeBack(address);
+            return check(cache.writeBack(address), *result, "writeBack",
+                    address);
+        }
+
+        bool writeBackNoRU(uint64_t address)
+        {
+            return check(cache.writeBackNoRU(address),
+                    ref.writeBackNoRU(address), "writeBackNoRU", address);
+        }
+
+        bool insertMru(block_t block, block_result_t *evicted)
+        {
+            *evicted = ref.insertMru(block);
+            return check(cache.insertMru(block), *evicted, "insertMru",
+                    blockAddress(block));
+        }
+
+        bool insertLru(block_t block, block_result_t *evicted)
+        {
+            *evicted = ref.insertLru(block);
+            return check(cache.insertLru(block), *evicted, "insertLru",
+                    blockAddress(block));
+        }
+
+        /**
+         * @brief Both hold the same blocks in the set address maps to
+         */
+        bool sameSet(uint64_t address)
+        {
+            const std::list<block_t>& set = ref.contents(address);
+            if (cache.getSize(address) != set.size()) {
+                std::cout << name << ": set of block " << address << " holds "
+                          << cache.getSize(address) << " blocks, expected "
+                          << set.size() << std::endl;
+                return false;
+            }
+            for (std::list<block_t>::const_iterator it = set.begin();
+                    it != set.end(); ++it) {
+                if (!check(cache.seek(blockAddress(*it)), blockFound(*it),
+                            "seek", blockAddress(*it))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+};
+
+/**
+ * @brief Random calls on block addresses spread over a few sets
+ *
+ * Tags are full 64-bit random numbers, so that aliasing in the high bits of
+ * a block address shows up. The pool holds twice as many blocks as fit in
+ * the sets used, so both hits and evictions are common.
+ *
+ * For sets with a TagIndex, part of the pool has tags whose home is the
+ * last bucket or the first one, so that long probe clusters form, wrap
+ * around the end of the buckets and have members removed from their middle.
+ */
+template <class Cache>
+static bool check_random(Cache& cache, uint64_t c, uint64_t b, uint64_t s,
+        uint64_t ways, const std::string& name)
+{
+    LruChecker<Cache> checker(cache, c, b, s, ways, name);
+    uint64_t indexBits = c - s - b;
+    uint64_t setsUsed = std::min(1UL << indexBits, 4UL);
+
+    std::mt19937_64 rng(c * 4096 + s * 64 + b);
+    std::vector<uint64_t> pool(2 * ways * setsUsed);
+    uint64_t lastBucket = 2 * (1UL << clog2(ways)) - 1;
+    for (size_t i = 0; i < pool.size(); ++i) {
+        uint64_t tag = rng() >> indexBits;
+        if (ways >= TAG_INDEX_MIN_WAYS && i < pool.size() / 8) {
+            while (home_bucket(tag, ways) != (i % 2 ? 0 : lastBucket)) {
+                tag = rng() >> indexBits;
+            }
+        }
+        pool[i] = (tag << indexBits) | (rng() % setsUsed);
+    }
+
+    block_result_t result;
+    for (uint64_t i = 0; i < 100 * pool.size(); ++i) {
+        uint64_t address = pool[rng() % pool.size()];
+        uint64_t op = rng() % 8;
+        bool ok;
+        if (op < 3) {
+            ok = checker.read(address, &result);
+        } else if (op < 6) {
+            ok = checker.writeBack(address, &result);
+        } else { // never fills, like a writeback into L2
+            ok = checker.writeBackNoRU(address);
+            result.found = true;
+        }
+        // Blocks are only inserted after a miss, as the simulator does
+        if (ok && !result.found) {
+            block_t block = makeBlock(address, (rng() & 1) != 0,
+                    (rng() & 2) != 0);
+            ok = (op & 1) ? checker.insertMru(block, &result)
+                : checker.insertLru(block, &result);
+        }
+        if (!ok || (i % same_set_interval(ways) == 0
+                    && !checker.sameSet(address))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Use the cache the way the simulator does for a trace
+ *
+ * Each access reads or writes back its block and fills it at MRU on a
+ * miss, like L1. Each miss also puts the next block in at LRU when it is
+ * absent, like a prefetch into L2, and an evicted block is written back
+ * without moving, like an L1 victim landing in L2. Only the start of each
+ * trace is used; the reference is slow in a debug build.
+ */
+template <class Cache>
+static bool check_trace(Cache& cache, uint64_t c, uint64_t b, uint64_t s,
+        uint64_t ways, const std::string& name, const char *path)
+{
+    LruChecker<Cache> checker(cache, c, b, s, ways, name + ": " + path);
+
+    TraceReader reader(path);
+    reader.limit(TRACE_ACCESSES);
+    uint64_t addr;
+    char rw;
+    uint64_t n = 0;
+    block_result_t result;
+    while (reader.next(&addr, &rw)) {
+        uint64_t address = addr >> b;
+        bool isWrite = (rw == WRITE);
+        bool ok = isWrite ? checker.writeBack(address, &result)
+            : checker.read(address, &result);
+        if (ok && !result.found) {
+            ok = checker.insertMru(makeBlock(address, isWrite), &result);
+            if (ok && result.found) {
+                ok = checker.writeBackNoRU(blockAddress(result.block) + 1UL);
+            }
+            if (ok && !cache.contains(address + 1UL)) {
+                ok = checker.insertLru(makeBlock(address + 1UL, false, true),
+                        &result);
+            }
+        }
+        if (!ok || (++n % same_set_interval(ways) == 0
+                    && !checker.sameSet(address))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Run the random and the trace checks on one geometry
+ */
+template <class G>
+static bool check_geometry(uint64_t c, uint64_t b, uint64_t s, uint64_t ways,
+        const std::string& kind, int argc, char *argv[])
+{
+    std::ostringstream name;
+    name << kind << " c=" << c << " b=" << b << " s=" << s << " ways="
+         << ways;
+
+    WaysLruCache<G> cache;
+    cache.init(c, b, s, ways);
+    if (!check_random(cache, c, b, s, ways, name.str())) {
+        return false;
+    }
+    for (int i = 1; i < argc; ++i) {
+        cache.init(c, b, s, ways);
+        if (!check_trace(cache, c, b, s, ways, name.str(), argv[i])) {
+            return false;
+        }
+    }
+    std::cout << name.str() << ": ok" << std::endl;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cout << "./lru-cache-test <trace>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Direct-mapped up to the widest packed sets, fully associative, and
+    // one and two byte blocks
+    bool ok = check_geometry<DynamicGeometry>(9, 6, 0, 1, "dynamic", argc, argv)
+        && check_geometry<DynamicGeometry>(10, 5, 1, 2, "dynamic", argc, argv)
+        && check_geometry<DynamicGeometry>(9, 1, 3, 8, "dynamic", argc, argv)
+        && check_geometry<DynamicGeometry>(8, 0, 4, 16, "dynamic", argc, argv)
+        && check_geometry<DynamicGeometry>(9, 6, 3, 8, "dynamic", argc, argv)
+        && check_geometry<FixedGeometry<15, 4, 6> >(15, 6, 4, 16, "fixed",
+                argc, argv)
+        && check_geometry<FixedGeometry<18, 3, 6> >(18, 6, 3, 8, "fixed",
+                argc, argv)
+        && check_geometry<FixedGeometry<12, 1, 5> >(12, 5, 1, 2, "fixed",
+                argc, argv);
+
+    // WayList sets, the narrowest and widest TagIndex sets, and a set with
+    // fewer ways than slots
+    ok = ok
+        && check_geometry<DynamicGeometry>(10, 3, 5, 17, "dynamic",
+                argc, argv)
+        && check_geometry<DynamicGeometry>(13, 6, 6, 64, "dynamic",
+                argc, argv)
+        && check_geometry<DynamicGeometry>(9, 0, 7, 127, "dynamic",
+                argc, argv)
+        && check_geometry<DynamicGeometry>(10, 1, 7, 128, "dynamic",
+                argc, argv)
+        && check_geometry<DynamicGeometry>(13, 0, 12, 4096, "dynamic",
+                argc, argv)
+        && check_geometry<FixedGeometry<14, 5, 6> >(14, 6, 5, 32, "fixed",
+                argc, argv)
+        && check_geometry<FixedGeometry<15, 7, 6> >(15, 6, 7, 128, "fixed",
+                argc, argv);
+    return ok ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file runs_test.cpp
+ * @brief Checks that every access entry point gives the same statistics
+ *
+ * Usage: ./runs-test <trace>...
+ *
+ * Simulates each trace one access at a time with cache_access() as the
+ * reference, then again with cache_access_batch() and with runs of
+ * same-block accesses through cache_access_runs(), from both
+ * TraceReader::readRuns() and TraceBuffer::fillRuns().
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cache.hpp"
+#include "trace.hpp"
+#include "test_util.hpp"
+
+static cache_stats_t simulate_batches(const char *path, cache_config_t conf,
+        trace_batch_t *batch)
+{
+    cache_stats_t stats = cache_stats_t();
+    cache_init(&conf);
+    TraceReader reader(path);
+    size_t n;
+    while ((n = reader.read(batch->addr, batch->write, TRACE_BATCH_SIZE))) {
+        cache_access_batch(batch->addr, batch->write, n, &stats);
+    }
+    cache_cleanup(&stats);
+    return stats;
+}
+
+static cache_stats_t simulate_read_runs(const char *path, cache_config_t conf,
+        trace_batch_t *batch)
+{
+    cache_stats_t stats = cache_stats_t();
+    cache_init(&conf);
+    TraceReader reader(path);
+    size_t n;
+    while ((n = reader.readRuns(batch->addr, batch->write,
+                    batch->repeat_reads, batch->repeat_writes,
+                    TRACE_BATCH_SIZE, conf.b))) {
+        cache_access_runs(batch->addr, batch->write, batch->repeat_reads,
+                batch->repeat_writes, n, &stats);
+    }
+    cache_cleanup(&stats);
+    return stats;
+}
+
+static cache_stats_t simulate_buffer_runs(const TraceBuffer& buffer,
+        cache_config_t conf, trace_batch_t *batch)
+{
+    cache_stats_t stats = cache_stats_t();
+    cache_init(&conf);
+    size_t cursor = 0;
+    while (buffer.fillRuns(&cursor, conf.b, batch)) {
+        cache_access_runs(batch->addr, batch->write, batch->repeat_reads,
+                batch->repeat_writes, batch->n, &stats);
+    }
+    cache_cleanup(&stats);
+    return stats;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cout << "./runs-test <trace>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<cache_config_t> confs = test_configs();
+    std::unique_ptr<trace_batch_t> batch(new trace_batch_t);
+    bool ok = true;
+
+    for (int i = 1; i < argc; ++i) {
+        TraceReader reader(argv[i]);
+        TraceBuffer buffer(reader);
+
+        for (size_t j = 0; j < confs.size(); ++j) {
+            std::ostringstream what;
+            what << argv[i] << ": " << confs[j];
+
+            cache_stats_t want = simulate_accesses(argv[i], confs[j]);
+            if (want.num_misses_l1 == 0) {
+                std::cout << what.str() << ": no L1 misses" << std::endl;
+                ok = false;
+            }
+            ok = same_stats(simulate_batches(argv[i], confs[j], batch.get()),
+                    want, what.str() + ": cache_access_batch") && ok;
+            ok = same_stats(simulate_read_runs(argv[i], confs[j],
+                        batch.get()),
+                    want, what.str() + ": readRuns") && ok;
+            ok = same_stats(simulate_buffer_runs(buffer, confs[j],
+                        batch.get()),
+                    want, what.str() + ": fillRuns") && ok;
+        }
+        std::cout << argv[i] << ": " << confs.size()
+                  << " configurations checked" << std::endl;
+    }
+    return ok ? 0 : EXIT_FAILURE;
+}
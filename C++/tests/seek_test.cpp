@@ -0,0 +1,192 @@
+/**
+ * @file seek_test.cpp
+ * @brief Checks that seeking into a trace lands on the right access
+ *
+ * Usage: ./seek-test <cachesim-convert> <cachesim-index> <trace>...
+ *
+ * Each trace is checked as text and converted to packed and delta traces.
+ * In every format seek(start) followed by limit(count) must read exactly the
+ * accesses a linear decode finds at [start, start + count): without a
+ * sidecar index, with one from cachesim-index, and with a stale index whose
+ * size or mtime does not match the trace, which must be ignored.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "trace.hpp"
+#include "test_util.hpp"
+
+// Accesses between the index entries cachesim-index is asked for
+static const uint64_t INDEX_INTERVAL = 1000;
+
+// Window lengths; the last ones reach past the end from the later starts
+static const uint64_t WINDOW_COUNTS[] = {0, 1, 5000};
+
+/**
+ * @brief Starts around index entries and the end of a trace of total
+ * accesses, including ones past it
+ */
+static std::vector<uint64_t> window_starts(uint64_t total)
+{
+    uint64_t starts[] = {
+        0, 1, INDEX_INTERVAL - 1, INDEX_INTERVAL, INDEX_INTERVAL + 1, 4321,
+        total / 2, total - 4000, total - 1, total, total + 1,
+    };
+    return std::vector<uint64_t>(starts, starts + sizeof(starts)
+            / sizeof(starts[0]));
+}
+
+/**
+ * @brief Check every window of a trace against its linear decode
+ * @param quiet only report whether all windows matched
+ */
+static bool check_windows(const std::string& path,
+        const std::vector<test_access_t>& want, const std::string& what,
+        bool quiet)
+{
+    TraceReader reader(path.c_str());
+    bool ok = true;
+    for (uint64_t start : window_starts(want.size())) {
+        for (uint64_t count : WINDOW_COUNTS) {
+            std::ostringstream window;
+            window << what << ": seek(" << start << ") limit(" << count
+                   << ")";
+
+            bool found = reader.seek(start);
+            if (found != (start <= want.size())) {
+                if (!quiet) {
+                    std::cout << window.str() << ": seek returned " << found
+                              << std::endl;
+                }
+                ok = false;
+                continue;
+            }
+            reader.limit(count);
+
+            size_t from = std::min<size_t>(start, want.size());
+            size_t to = from + std::min<size_t>(count, want.size() - from);
+            std::vector<test_access_t> expect(want.begin()
+                    + static_cast<ptrdiff_t>(from),
+                    want.begin() + static_cast<ptrdiff_t>(to));
+            std::vector<test_access_t> got = read_accesses(reader);
+            if (!quiet) {
+                ok = same_accesses(got, expect, window.str()) && ok;
+                continue;
+            }
+            for (size_t i = 0; ok && i < got.size(); ++i) {
+                ok = i < expect.size() && got[i].addr == expect[i].addr
+                    && got[i].rw == expect[i].rw;
+            }
+            ok = ok && got.size() == expect.size();
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief Rewrite the index of a trace with every entry one access off, and
+ * with a header claiming the given size and mtime
+ */
+static void write_skewed_index(const std::string& indexPath,
+        const std::vector<trace_index_entry_t>& entries, uint64_t size,
+        uint64_t mtime)
+{
+    std::vector<trace_index_entry_t> skewed(entries);
+    for (trace_index_entry_t& at : skewed) {
+        ++at.ordinal;
+    }
+    if (!trace_write_index(indexPath, size, mtime, skewed)) {
+        std::cout << indexPath << ": could not write index" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @param packed whether path is a packed trace, which is seeked directly
+ * and never reads its index
+ */
+static bool check_format(const char *indexer, const std::string& path,
+        bool packed, const std::string& what)
+{
+    std::vector<test_access_t> want;
+    uint64_t size;
+    uint64_t mtime;
+    {
+        TraceReader reader(path.c_str());
+        want = read_accesses(reader);
+        size = reader.size();
+        mtime = reader.mtime();
+    }
+
+    bool ok = check_windows(path, want, what + ", no index", false);
+
+    std::ostringstream cmd;
+    cmd << "'" << indexer << "' -n " << INDEX_INTERVAL << " '" << path
+        << "' > /dev/null";
+    std::string indexPath = path + TRACE_INDEX_SUFFIX;
+    std::vector<trace_index_entry_t> entries;
+    if (std::system(cmd.str().c_str()) != 0
+            || !trace_read_index(indexPath, size, mtime, entries)) {
+        std::cout << what << ": " << cmd.str() << " failed" << std::endl;
+        std::remove(indexPath.c_str());
+        return false;
+    }
+    ok = check_windows(path, want, what + ", index", false) && ok;
+
+    // A matching index must be resumed from, so a skewed one goes wrong
+    write_skewed_index(indexPath, entries, size, mtime);
+    if (!packed && check_windows(path, want, "", true)) {
+        std::cout << what << ": skewed index not used" << std::endl;
+        ok = false;
+    }
+
+    write_skewed_index(indexPath, entries, size + 1, mtime);
+    ok = check_windows(path, want, what + ", index of another size", false)
+        && ok;
+    write_skewed_index(indexPath, entries, size, mtime + 1);
+    ok = check_windows(path, want, what + ", index of another mtime", false)
+        && ok;
+
+    std::remove(indexPath.c_str());
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        std::cout << "./seek-test <cachesim-convert> <cachesim-index> "
+                     "<trace>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    for (int i = 3; i < argc; ++i) {
+        // Work on copies so no index is left next to the bundled traces
+        std::ifstream in(argv[i], std::ios::binary);
+        std::ostringstream text;
+        text << in.rdbuf();
+        std::string textPath = write_temp_file(text.str());
+        std::string packedPath = write_temp_file("");
+        std::string deltaPath = write_temp_file("");
+
+        std::string name(argv[i]);
+        ok = convert_trace(argv[1], textPath, packedPath, false)
+            && convert_trace(argv[1], textPath, deltaPath, true) && ok;
+        ok = check_format(argv[2], textPath, false, name + ": text") && ok;
+        ok = check_format(argv[2], packedPath, true, name + ": packed") && ok;
+        ok = check_format(argv[2], deltaPath, false, name + ": delta") && ok;
+        std::cout << name << ": seeks checked" << std::endl;
+
+        std::remove(textPath.c_str());
+        std::remove(packedPath.c_str());
+        std::remove(deltaPath.c_str());
+    }
+    return ok ? 0 : EXIT_FAILURE;
+}
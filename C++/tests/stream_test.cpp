@@ -0,0 +1,191 @@
+/**
+ * @file stream_test.cpp
+ * @brief Checks that traces read from a pipe decode like mapped files
+ *
+ * Usage: ./stream-test <cachesim-convert> <trace>...
+ *
+ * Each trace, as text and converted to packed and delta traces, is written
+ * into a FIFO in chunks of odd sizes, so records and lines are split across
+ * reads, and must decode to the same accesses as the file itself: one at a
+ * time, in batches, and from a seek into the stream. A generated text trace
+ * with a line longer than the stream buffer is checked the same way.
+ */
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.hpp"
+#include "test_util.hpp"
+
+// Sizes the writer cycles through for its writes into the FIFO
+static const size_t CHUNK_SIZES[] = {1, 3, 7, 10, 4093, 65537};
+
+static const uint64_t SEEK_START = 12345;
+static const uint64_t SEEK_COUNT = 54321;
+
+static std::string read_file(const std::string& path)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    std::ostringstream data;
+    data << in.rdbuf();
+    return data.str();
+}
+
+static void write_chunks(std::string fifo, std::string data)
+{
+    int fd = open(fifo.c_str(), O_WRONLY);
+    size_t done = 0;
+    for (size_t i = 0; fd >= 0 && done < data.size(); ++i) {
+        size_t len = std::min(CHUNK_SIZES[i % (sizeof(CHUNK_SIZES)
+                    / sizeof(CHUNK_SIZES[0]))], data.size() - done);
+        ssize_t got = write(fd, data.data() + done, len);
+        if (got <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(got);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/**
+ * @brief Decode data as it arrives through a FIFO
+ * @param batched decode with read() instead of next()
+ * @param window seek to SEEK_START and read SEEK_COUNT accesses
+ */
+static std::vector<test_access_t> decode_stream(const std::string& fifo,
+        const std::string& data, bool batched, bool window)
+{
+    std::thread writer(write_chunks, fifo, data);
+    std::vector<test_access_t> accesses;
+    {
+        TraceReader reader(fifo.c_str());
+        if (window) {
+            reader.seek(SEEK_START);
+            reader.limit(SEEK_COUNT);
+        }
+
+        if (batched) {
+            uint64_t addrs[1000];
+            uint8_t writes[1000];
+            size_t n;
+            while ((n = reader.read(addrs, writes, 1000))) {
+                for (size_t i = 0; i < n; ++i) {
+                    test_access_t access = {addrs[i],
+                        writes[i] ? WRITE : READ};
+                    accesses.push_back(access);
+                }
+            }
+        } else {
+            accesses = read_accesses(reader);
+        }
+
+        if (!window && reader.size() != data.size()) {
+            std::cout << fifo << ": stream size " << reader.size()
+                      << ", expected " << data.size() << std::endl;
+            accesses.clear();
+        }
+    }
+
+    // A reader that stopped early has closed the FIFO on the writer
+    writer.join();
+    return accesses;
+}
+
+static bool check_stream(const std::string& fifo, const std::string& path,
+        const std::string& what)
+{
+    std::string data = read_file(path);
+    TraceReader reader(path.c_str());
+    std::vector<test_access_t> want = read_accesses(reader);
+
+    size_t from = std::min<size_t>(SEEK_START, want.size());
+    size_t to = std::min<size_t>(from + SEEK_COUNT, want.size());
+    std::vector<test_access_t> window(want.begin()
+            + static_cast<ptrdiff_t>(from),
+            want.begin() + static_cast<ptrdiff_t>(to));
+
+    bool ok = same_accesses(decode_stream(fifo, data, false, false), want,
+            what + ": next");
+    ok = same_accesses(decode_stream(fifo, data, true, false), want,
+            what + ": read") && ok;
+    ok = same_accesses(decode_stream(fifo, data, false, true), window,
+            what + ": seek") && ok;
+    std::cout << what << ": " << want.size() << " accesses checked"
+              << std::endl;
+    return ok;
+}
+
+/**
+ * @brief A text trace with a run of blanks between an address and its flag
+ * longer than the stream buffer, between ordinary lines
+ */
+static std::string long_line_trace()
+{
+    std::string text;
+    for (int i = 0; i < 1000; ++i) {
+        text += "0x7fff5a8e1234 R\n";
+    }
+    text += "0x400123" + std::string(3 << 20, ' ') + "W\n";
+    for (int i = 0; i < 1000; ++i) {
+        text += "0x601040 W\n";
+    }
+    return text;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cout << "./stream-test <cachesim-convert> <trace>..."
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Let the writer see EPIPE once a windowed reader stops reading
+    signal(SIGPIPE, SIG_IGN);
+
+    char dir[] = "/tmp/cachesim-test-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        std::cout << "could not create a temporary directory" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string fifo = std::string(dir) + "/fifo";
+    if (mkfifo(fifo.c_str(), 0600) != 0) {
+        std::cout << "could not create " << fifo << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string longPath = write_temp_file(long_line_trace());
+    bool ok = check_stream(fifo, longPath, "long line");
+    std::remove(longPath.c_str());
+
+    for (int i = 2; i < argc; ++i) {
+        std::string packed = write_temp_file("");
+        std::string delta = write_temp_file("");
+        std::string name(argv[i]);
+        ok = convert_trace(argv[1], argv[i], packed, false)
+            && convert_trace(argv[1], argv[i], delta, true) && ok;
+        ok = check_stream(fifo, argv[i], name + ": text") && ok;
+        ok = check_stream(fifo, packed, name + ": packed") && ok;
+        ok = check_stream(fifo, delta, name + ": delta") && ok;
+        std::remove(packed.c_str());
+        std::remove(delta.c_str());
+    }
+
+    std::remove(fifo.c_str());
+    rmdir(dir);
+    return ok ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,208 @@
+/**
+ * @file test_util.hpp
+ * @brief Helpers shared by the cache simulator tests
+ *
+ * Every test is a plain executable taking the traces to run on as arguments
+ * and exiting with EXIT_FAILURE on the first mismatch.
+ */
+
+#ifndef TEST_UTIL_HPP
+#define TEST_UTIL_HPP
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "cache.hpp"
+#include "trace.hpp"
+
+inline cache_config_t test_config(uint64_t c, uint64_t C, uint64_t s,
+        uint64_t S, uint64_t b, uint64_t v, uint64_t k)
+{
+    cache_config_t conf;
+    conf.c = c;
+    conf.C = C;
+    conf.s = s;
+    conf.S = S;
+    conf.b = b;
+    conf.v = v;
+    conf.k = k;
+    return conf;
+}
+
+/**
+ * @brief Configurations the tests run every trace through
+ *
+ * Covers the defaults, a direct-mapped L1, the specialized sweep geometries
+ * and dynamic ones, levels with hundreds of ways, no victim cache or
+ * prefetcher at all, and blocks of one and two bytes, whose block addresses
+ * can use all 64 bits.
+ */
+inline std::vector<cache_config_t> test_configs()
+{
+    std::vector<cache_config_t> confs;
+    confs.push_back(cache_config_t());
+    confs.push_back(test_config(15, 18, 4, 3, 6, 0, 0));
+    confs.push_back(test_config(15, 18, 4, 3, 6, 0, 3));
+    confs.push_back(test_config(12, 15, 1, 2, 5, 3, 2));
+    confs.push_back(test_config(10, 14, 0, 0, 4, 1, 4));
+    confs.push_back(test_config(15, 17, 9, 7, 6, 4, 1));
+    confs.push_back(test_config(13, 20, 2, 8, 3, 2, 0));
+    confs.push_back(test_config(14, 14, 3, 5, 6, 5, 3));
+    confs.push_back(test_config(9, 11, 3, 4, 1, 16, 0));
+    confs.push_back(test_config(8, 10, 1, 2, 0, 3, 2));
+    return confs;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const cache_config_t& conf)
+{
+    return out << "c=" << conf.c << " C=" << conf.C << " s=" << conf.s
+               << " S=" << conf.S << " b=" << conf.b << " v=" << conf.v
+               << " k=" << conf.k;
+}
+
+/**
+ * @brief Simulate a whole trace one cache_access() at a time
+ *
+ * The reference every faster entry point is compared against.
+ */
+inline cache_stats_t simulate_accesses(const char *path, cache_config_t conf)
+{
+    cache_stats_t stats = cache_stats_t();
+    cache_init(&conf);
+    TraceReader reader(path);
+    uint64_t addr;
+    char rw;
+    while (reader.next(&addr, &rw)) {
+        cache_access(addr, rw, &stats);
+    }
+    cache_cleanup(&stats);
+    return stats;
+}
+
+// An access as decoded from a trace
+struct test_access_t {
+    uint64_t addr;
+    char rw;
+};
+
+/**
+ * @brief Decode every access a reader has left, up to any limit() set on it
+ */
+inline std::vector<test_access_t> read_accesses(TraceReader& reader)
+{
+    std::vector<test_access_t> accesses;
+    test_access_t access;
+    while (reader.next(&access.addr, &access.rw)) {
+        accesses.push_back(access);
+    }
+    return accesses;
+}
+
+/**
+ * @brief Compare two decoded traces, reporting the first difference under
+ * what
+ */
+inline bool same_accesses(const std::vector<test_access_t>& got,
+        const std::vector<test_access_t>& want, const std::string& what)
+{
+    for (size_t i = 0; i < got.size() && i < want.size(); ++i) {
+        if (got[i].addr != want[i].addr || got[i].rw != want[i].rw) {
+            std::cout << what << ": access " << i << " is " << std::hex
+                      << got[i].addr << " " << got[i].rw << ", expected "
+                      << want[i].addr << " " << want[i].rw << std::dec
+                      << std::endl;
+            return false;
+        }
+    }
+    if (got.size() != want.size()) {
+        std::cout << what << ": " << got.size() << " accesses, expected "
+                  << want.size() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Write data to a new temporary file
+ * @return its path; the caller removes the file
+ */
+inline std::string write_temp_file(const std::string& data)
+{
+    char path[] = "/tmp/cachesim-test-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || write(fd, data.data(), data.size())
+            != static_cast<ssize_t>(data.size())) {
+        std::cout << "could not write a temporary file" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    close(fd);
+    return path;
+}
+
+/**
+ * @brief Convert a trace with the cachesim-convert binary at converter
+ * @param delta use the delta encoding instead of packed records
+ */
+inline bool convert_trace(const char *converter, const std::string& in,
+        const std::string& out, bool delta)
+{
+    std::string cmd = std::string("'") + converter + "' "
+        + (delta ? "-d '" : "'") + in + "' '" + out + "' > /dev/null";
+    if (std::system(cmd.c_str()) != 0) {
+        std::cout << in << ": " << cmd << " failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#define TEST_STATS_FIELD(field) \
+    if (got.field != want.field) { \
+        std::cout << what << ": " #field " is " << got.field \
+                  << ", expected " << want.field << std::endl; \
+        same = false; \
+    }
+
+/**
+ * @brief Compare two finished simulations field by field
+ *
+ * Rates and times are computed the same way from the same counters, so they
+ * must match exactly too. Every differing field is reported under what.
+ */
+inline bool same_stats(const cache_stats_t& got, const cache_stats_t& want,
+        const std::string& what)
+{
+    bool same = true;
+    TEST_STATS_FIELD(num_accesses)
+    TEST_STATS_FIELD(num_accesses_writes)
+    TEST_STATS_FIELD(num_accesses_reads)
+    TEST_STATS_FIELD(num_misses_l1)
+    TEST_STATS_FIELD(num_misses_reads_l1)
+    TEST_STATS_FIELD(num_misses_writes_l1)
+    TEST_STATS_FIELD(num_hits_vc)
+    TEST_STATS_FIELD(num_misses_vc)
+    TEST_STATS_FIELD(num_misses_reads_vc)
+    TEST_STATS_FIELD(num_misses_writes_vc)
+    TEST_STATS_FIELD(num_misses_l2)
+    TEST_STATS_FIELD(num_misses_reads_l2)
+    TEST_STATS_FIELD(num_misses_writes_l2)
+    TEST_STATS_FIELD(num_write_backs)
+    TEST_STATS_FIELD(num_bytes_transferred)
+    TEST_STATS_FIELD(num_prefetches)
+    TEST_STATS_FIELD(num_useful_prefetches)
+    TEST_STATS_FIELD(hit_time_l1)
+    TEST_STATS_FIELD(hit_time_l2)
+    TEST_STATS_FIELD(hit_time_mem)
+    TEST_STATS_FIELD(miss_rate_l1)
+    TEST_STATS_FIELD(miss_rate_vc)
+    TEST_STATS_FIELD(miss_rate_l2)
+    TEST_STATS_FIELD(avg_access_time)
+    return same;
+}
+
+#undef TEST_STATS_FIELD
+
+#endif /* TEST_UTIL_HPP */
@@ -0,0 +1,124 @@
+/**
+ * @file text_decoder_test.cpp
+ * @brief Checks that every text line decoder gives the same accesses
+ *
+ * Usage: ./text-decoder-test <trace>...
+ *
+ * Each trace is decoded with the scalar parser as the reference and again
+ * with every SIMD decoder this CPU supports. A generated trace of unusual
+ * lines, which the SIMD decoders have to hand back to the scalar parser, is
+ * checked against the accesses it spells out.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "trace.hpp"
+#include "test_util.hpp"
+
+struct decoder_t {
+    uint32_t id;
+    const char *name;
+};
+
+static const decoder_t DECODERS[] = {
+    {TRACE_DECODER_SCALAR, "scalar"},
+    {TRACE_DECODER_SSE41, "sse4.1"},
+    {TRACE_DECODER_AVX2, "avx2"},
+};
+
+struct edge_line_t {
+    const char *text;
+    uint64_t addr;
+    char rw;
+};
+
+/**
+ * Lines without an address or flag, like the blank ones, are skipped and
+ * have no access
+ */
+static const edge_line_t EDGE_LINES[] = {
+    {"0x1 R\n", 0x1, READ},
+    {"0xffffffffffffffff W\n", 0xffffffffffffffffUL, WRITE},
+    {"0x0000000000000042 R\n", 0x42, READ},
+    {"0x7fffffffe0a8 R\r\n", 0x7fffffffe0a8UL, READ},
+    {"0x8 W\r\n", 0x8, WRITE},
+    {"0x1234   W  \n", 0x1234, WRITE},
+    {"0xABCDEF W\n", 0xabcdef, WRITE},
+    {"0x7fFfAbCd9e R\n", 0x7fffabcd9eUL, READ},
+    {"0xABCdef\tR\t\n", 0xabcdef, READ},
+    {"abc123 W\n", 0xabc123, WRITE},
+    {"7 R\n", 0x7, READ},
+    {"0X10 R\n", 0x10, READ},
+    {"\n", 0, 0},
+    {"   \n", 0, 0},
+    {"0x400000 R\n", 0x400000, READ},
+};
+
+/**
+ * @brief Build the edge case trace and the accesses it holds
+ *
+ * The lines appear twice: first with more lines after them, where the SIMD
+ * decoders get to look at them, then at the end of the trace, where they are
+ * too close to the end for a SIMD window. The trace ends without a newline.
+ */
+static std::string edge_trace(std::vector<test_access_t>& accesses)
+{
+    std::string text;
+    for (int copy = 0; copy < 2; ++copy) {
+        for (const edge_line_t& line : EDGE_LINES) {
+            text += line.text;
+            if (line.rw) {
+                test_access_t access = {line.addr, line.rw};
+                accesses.push_back(access);
+            }
+        }
+    }
+    text += "0x12345 W";
+    test_access_t last = {0x12345, WRITE};
+    accesses.push_back(last);
+    return text;
+}
+
+static std::vector<test_access_t> decode(const char *path, uint32_t decoder)
+{
+    trace_select_decoder(decoder);
+    TraceReader reader(path);
+    return read_accesses(reader);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cout << "./text-decoder-test <trace>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<test_access_t> edgeWant;
+    std::string edgePath = write_temp_file(edge_trace(edgeWant));
+    bool ok = true;
+
+    for (const decoder_t& decoder : DECODERS) {
+        if (!trace_select_decoder(decoder.id)) {
+            std::cout << decoder.name << ": not supported here, skipped"
+                      << std::endl;
+            continue;
+        }
+
+        ok = same_accesses(decode(edgePath.c_str(), decoder.id), edgeWant,
+                std::string("edge cases: ") + decoder.name) && ok;
+        for (int i = 1; i < argc; ++i) {
+            ok = same_accesses(decode(argv[i], decoder.id),
+                    decode(argv[i], TRACE_DECODER_SCALAR),
+                    std::string(argv[i]) + ": " + decoder.name) && ok;
+        }
+        std::cout << decoder.name << ": " << argc - 1 << " traces checked"
+                  << std::endl;
+    }
+
+    std::remove(edgePath.c_str());
+    return ok ? 0 : EXIT_FAILURE;
+}
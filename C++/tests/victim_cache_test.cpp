@@ -0,0 +1,206 @@
+/**
+ * @file victim_cache_test.cpp
+ * @brief Checks the victim cache ring against a std::list FIFO
+ *
+ * Usage: ./victim-cache-test <trace>...
+ *
+ * The reference is the linked-list VictimSet the ring replaced, holding
+ * exactly v blocks: new blocks go in at the front, the back falls out once
+ * it is full, and a hit is removed wherever it sits.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <random>
+#include <vector>
+
+#include "cache.hpp"
+#include "cache_engine.hpp"
+#include "trace.hpp"
+#include "test_util.hpp"
+
+class ListVictimCache
+{
+    private:
+        uint64_t v;
+        std::list<block_t> set;
+
+    public:
+        explicit ListVictimCache(uint64_t v_i) : v(v_i)
+        {}
+
+        block_result_t insert(block_t block)
+        {
+            if (v == 0) {
+                return blockFound(block);
+            }
+            set.push_front(block);
+            if (set.size() <= v) {
+                return BLOCK_NONE;
+            }
+            block_t fifoOut = set.back();
+            set.pop_back();
+            return blockFound(fifoOut);
+        }
+
+        block_result_t retrieve(uint64_t address)
+        {
+            for (std::list<block_t>::iterator it = set.begin();
+                    it != set.end(); ++it) {
+                if (blockAddress(*it) == address) {
+                    block_t found = *it;
+                    set.erase(it);
+                    return blockFound(found);
+                }
+            }
+            return BLOCK_NONE;
+        }
+};
+
+static bool same_result(block_result_t a, block_result_t b)
+{
+    return a.found == b.found && (!a.found
+            || (a.block.address == b.block.address
+                && a.block.flags == b.block.flags));
+}
+
+/**
+ * @brief Random inserts and lookups over a small pool of blocks
+ */
+static bool check_random(uint64_t v)
+{
+    VictimCache ring;
+    ring.init(v, 6);
+    ListVictimCache list(v);
+
+    std::mt19937_64 rng(v);
+    uint64_t pool = 2 * v + 3;
+    for (uint64_t i = 0; i < 100000; ++i) {
+        uint64_t address = rng() % pool;
+        block_result_t expected = list.retrieve(address);
+        block_result_t got = ring.retrieve(address);
+        if (!same_result(got, expected)) {
+            std::cout << "v=" << v << ": lookup " << i << " of block "
+                      << address << " differs" << std::endl;
+            return false;
+        }
+
+        // Blocks are only inserted while absent, as on an L1 eviction
+        if (!got.found && (rng() & 1)) {
+            block_t block = makeBlock(address, (rng() & 2) != 0);
+            expected = list.insert(block);
+            got = ring.insert(block);
+            if (!same_result(got, expected)) {
+                std::cout << "v=" << v << ": insert " << i << " of block "
+                          << address << " evicted differently" << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Drive both victim caches with the L1 evictions of a trace
+ *
+ * The victim cache only ever sees L1 misses and L1 victims, neither of
+ * which depend on L2, so the reference counts must also match the VC
+ * counters of the full simulator.
+ */
+static bool check_trace(const char *path, cache_config_t conf)
+{
+    LruCache<DynamicGeometry> l1;
+    l1.init(conf.c, conf.b, conf.s);
+    VictimCache ring;
+    ring.init(conf.v, conf.b);
+    ListVictimCache list(conf.v);
+
+    cache_stats_t stats = cache_stats_t();
+    cache_init(&conf);
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    TraceReader reader(path);
+    uint64_t addr;
+    char rw;
+    while (reader.next(&addr, &rw)) {
+        cache_access(addr, rw, &stats);
+
+        bool isWrite = (rw == WRITE);
+        uint64_t address = addr >> conf.b;
+        block_result_t l1Hit = isWrite ? l1.writeBack(address)
+            : l1.read(address);
+        if (l1Hit.found) {
+            continue;
+        }
+
+        block_result_t expected = list.retrieve(address);
+        block_result_t got = ring.retrieve(address);
+        if (!same_result(got, expected)) {
+            std::cout << path << ": " << conf << ": lookup of block "
+                      << address << " differs" << std::endl;
+            return false;
+        }
+        if (expected.found) {
+            ++hits;
+        } else {
+            ++misses;
+        }
+
+        bool dirty = isWrite || (expected.found && isDirty(expected.block));
+        block_result_t l1Evicted = l1.insertMru(makeBlock(address, dirty));
+        if (l1Evicted.found) {
+            expected = list.insert(l1Evicted.block);
+            got = ring.insert(l1Evicted.block);
+            if (!same_result(got, expected)) {
+                std::cout << path << ": " << conf << ": insert of block "
+                          << blockAddress(l1Evicted.block)
+                          << " evicted differently" << std::endl;
+                return false;
+            }
+        }
+    }
+    cache_cleanup(&stats);
+
+    if (stats.num_hits_vc != hits || stats.num_misses_vc != misses) {
+        std::cout << path << ": " << conf << ": simulator VC hits/misses "
+                  << stats.num_hits_vc << "/" << stats.num_misses_vc
+                  << ", reference " << hits << "/" << misses << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cout << "./victim-cache-test <trace>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Powers of two, either side of them, and no victim cache at all
+    const uint64_t sizes[] = {0, 1, 2, 3, 4, 5, 7, 8, 9, 31, 64, 65, 100};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        if (!check_random(sizes[i])) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<cache_config_t> confs = test_configs();
+    // Victim caches that don't fill their ring
+    confs.push_back(test_config(12, 15, 1, 2, 5, 7, 2));
+    confs.push_back(test_config(12, 15, 1, 2, 5, 9, 2));
+    confs.push_back(test_config(12, 15, 1, 2, 5, 100, 2));
+    for (int i = 1; i < argc; ++i) {
+        for (size_t j = 0; j < confs.size(); ++j) {
+            if (!check_trace(argv[i], confs[j])) {
+                return EXIT_FAILURE;
+            }
+        }
+        std::cout << argv[i] << ": " << confs.size()
+                  << " configurations checked" << std::endl;
+    }
+    return 0;
+}
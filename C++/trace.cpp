@@ -0,0 +1,441 @@
+/**
+ * @file trace.cpp
+ * @brief Trace file formats and reader for the cache simulator
+ */
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool trace_write_header(FILE *fout, uint32_t encoding, uint64_t num_records)
+{
+    uint8_t header[TRACE_HEADER_SIZE];
+    memcpy(header, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    trace_store_le64(header + 8,
+            TRACE_VERSION | static_cast<uint64_t>(encoding) << 32);
+    trace_store_le64(header + 16, num_records);
+    return fwrite(header, 1, sizeof(header), fout) == sizeof(header);
+}
+
+bool trace_write_index(const std::string& path, uint64_t trace_size,
+        uint64_t trace_mtime, const std::vector<trace_index_entry_t>& entries)
+{
+    FILE *fout = fopen(path.c_str(), "wb");
+    if (fout == NULL) {
+        return false;
+    }
+
+    uint8_t header[TRACE_INDEX_HEADER_SIZE];
+    memcpy(header, TRACE_INDEX_MAGIC, sizeof(TRACE_INDEX_MAGIC));
+    trace_store_le64(header + 8, TRACE_INDEX_VERSION);
+    trace_store_le64(header + 16, trace_size);
+    trace_store_le64(header + 24, trace_mtime);
+    trace_store_le64(header + 32, entries.size());
+    bool ok = fwrite(header, 1, sizeof(header), fout) == sizeof(header);
+
+    uint8_t rec[TRACE_INDEX_ENTRY_SIZE];
+    for (size_t i = 0; ok && i < entries.size(); ++i) {
+        trace_store_le64(rec, entries[i].ordinal);
+        trace_store_le64(rec + 8, entries[i].offset);
+        for (size_t j = 0; j < TRACE_DELTA_STREAMS; ++j) {
+            trace_store_le64(rec + 16 + 8 * j, entries[i].prev[j]);
+        }
+        ok = fwrite(rec, 1, sizeof(rec), fout) == sizeof(rec);
+    }
+
+    return (fclose(fout) == 0) && ok;
+}
+
+bool trace_read_index(const std::string& path, uint64_t trace_size,
+        uint64_t trace_mtime, std::vector<trace_index_entry_t>& entries)
+{
+    FILE *fin = fopen(path.c_str(), "rb");
+    if (fin == NULL) {
+        return false;
+    }
+
+    // A stale index of a different or since rewritten trace file is as good
+    // as none
+    uint8_t header[TRACE_INDEX_HEADER_SIZE];
+    bool ok = fread(header, 1, sizeof(header), fin) == sizeof(header)
+        && memcmp(header, TRACE_INDEX_MAGIC, sizeof(TRACE_INDEX_MAGIC)) == 0
+        && trace_load_le64(header + 8) == TRACE_INDEX_VERSION
+        && trace_load_le64(header + 16) == trace_size
+        && trace_load_le64(header + 24) == trace_mtime;
+
+    uint64_t count = ok ? trace_load_le64(header + 32) : 0;
+    uint8_t rec[TRACE_INDEX_ENTRY_SIZE];
+    entries.clear();
+    for (uint64_t i = 0; ok && i < count; ++i) {
+        ok = fread(rec, 1, sizeof(rec), fin) == sizeof(rec);
+        trace_index_entry_t at;
+        at.ordinal = trace_load_le64(rec);
+        at.offset = trace_load_le64(rec + 8);
+        for (size_t j = 0; j < TRACE_DELTA_STREAMS; ++j) {
+            at.prev[j] = trace_load_le64(rec + 16 + 8 * j);
+        }
+        // Entries must be in order and point inside the trace
+        ok = ok && at.offset <= trace_size
+            && (entries.empty() || entries.back().ordinal <= at.ordinal);
+        entries.push_back(at);
+    }
+    fclose(fin);
+
+    if (!ok) {
+        entries.clear();
+    }
+    return ok;
+}
+
+// Initial size of the buffer a stream is decoded from; it only grows to fit
+// a text line longer than that
+static const size_t STREAM_BUFFER_SIZE = 1UL << 20;
+
+static void trace_fail(const char *path, const char *what)
+{
+    std::cout << (path ? path : "stdin") << ": " << what << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+TraceReader::TraceReader(const char *path)
+    : data(NULL), pos(NULL), end(NULL), dataEnd(NULL), firstOffset(0),
+      mapLen(0), filled(0), ownedOffset(0), streamFd(-1), modTime(0),
+      binary(false), encoding(TRACE_ENCODING_PACKED), totalRecords(0),
+      remaining(0), ordinal(0), windowLeft(UINT64_MAX), havePending(false),
+      pendingAddr(0), pendingRw(READ)
+{
+    for (size_t i = 0; i < TRACE_DELTA_STREAMS; ++i) {
+        prev[i] = 0;
+    }
+
+    int fd = path ? open(path, O_RDONLY) : STDIN_FILENO;
+    if (fd < 0) {
+        trace_fail(path, "could not open trace");
+    }
+
+    struct stat st;
+    bool haveStat = fstat(fd, &st) == 0;
+    if (path && haveStat) {
+        // Ties a chunk index to this version of the file
+        modTime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000UL
+            + static_cast<uint64_t>(st.st_mtim.tv_nsec);
+    }
+    if (haveStat && S_ISREG(st.st_mode) && st.st_size > 0) {
+        size_t len = static_cast<size_t>(st.st_size);
+        void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, len, MADV_SEQUENTIAL);
+            data = static_cast<const uint8_t *>(map);
+            mapLen = len;
+        }
+    }
+
+    if (path) {
+        tracePath = path;
+    }
+    if (mapLen == 0) {
+        // Not mappable, stream it instead; read at least a header's worth to
+        // detect the format from
+        owned.resize(STREAM_BUFFER_SIZE);
+        data = owned.data();
+        streamFd = fd;
+        while (filled < TRACE_HEADER_SIZE && streamFd >= 0) {
+            fill();
+        }
+    } else if (path) {
+        close(fd);
+    }
+
+    pos = data;
+    end = data + (mapLen ? mapLen : filled);
+    dataEnd = end;
+
+    // Anything not starting with the magic is treated as a text trace
+    size_t len = static_cast<size_t>(end - pos);
+    if (len < sizeof(TRACE_MAGIC)
+            || memcmp(pos, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+        frame();
+        return;
+    }
+    if (len < TRACE_HEADER_SIZE) {
+        trace_fail(path, "truncated binary trace header");
+    }
+    uint64_t versionWord = trace_load_le64(pos + 8);
+    if ((versionWord & 0xffffffffUL) != TRACE_VERSION) {
+        trace_fail(path, "unsupported binary trace version");
+    }
+    encoding = static_cast<uint32_t>(versionWord >> 32);
+    if (encoding != TRACE_ENCODING_PACKED
+            && encoding != TRACE_ENCODING_DELTA) {
+        trace_fail(path, "unsupported binary trace encoding");
+    }
+
+    binary = true;
+    remaining = trace_load_le64(pos + 16);
+    pos += TRACE_HEADER_SIZE;
+    firstOffset = TRACE_HEADER_SIZE;
+
+    // Never read past the announced records, nor past a truncated tail
+    totalRecords = remaining;
+    if (mapLen == 0) {
+        frame();
+    } else if (encoding == TRACE_ENCODING_PACKED) {
+        uint64_t available = (len - TRACE_HEADER_SIZE) / TRACE_RECORD_SIZE;
+        if (remaining > available) {
+            remaining = available;
+        }
+        end = pos + remaining * TRACE_RECORD_SIZE;
+        totalRecords = remaining;
+    }
+}
+
+void TraceReader::fill()
+{
+    ssize_t got;
+    do {
+        got = ::read(streamFd, owned.data() + filled, owned.size() - filled);
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) {
+        trace_fail(tracePath.empty() ? NULL : tracePath.c_str(),
+                "could not read trace");
+    }
+    if (got == 0) {
+        if (!tracePath.empty()) {
+            close(streamFd);
+        }
+        streamFd = -1;
+    }
+    filled += static_cast<size_t>(got);
+}
+
+void TraceReader::frame()
+{
+    if (mapLen) {
+        return;
+    }
+    dataEnd = data + filled;
+    end = dataEnd;
+
+    if (binary && encoding == TRACE_ENCODING_PACKED) {
+        uint64_t records = std::min<uint64_t>(remaining,
+                static_cast<size_t>(dataEnd - pos) / TRACE_RECORD_SIZE);
+        end = pos + records * TRACE_RECORD_SIZE;
+        remaining -= records;
+    } else if (streamFd < 0) {
+        return; // whatever is left is all there is
+    } else if (binary) {
+        end = dataEnd - pos >= static_cast<ptrdiff_t>(TRACE_DELTA_MAX_SIZE)
+            ? dataEnd - (TRACE_DELTA_MAX_SIZE - 1) : pos;
+    } else {
+        while (end > pos && end[-1] != '\n') {
+            --end;
+        }
+    }
+}
+
+bool TraceReader::refill()
+{
+    if (streamFd < 0 || (binary && remaining == 0)) {
+        return false;
+    }
+
+    size_t keep = static_cast<size_t>(dataEnd - pos);
+    ownedOffset += static_cast<uint64_t>(pos - data);
+    memmove(owned.data(), pos, keep);
+    filled = keep;
+    pos = data;
+    do {
+        if (filled == owned.size()) { // a text line longer than the buffer
+            owned.resize(2 * owned.size());
+            data = owned.data();
+            pos = data;
+        }
+        fill();
+        frame();
+    } while (end == pos && streamFd >= 0);
+    return true;
+}
+
+trace_index_entry_t TraceReader::mark() const
+{
+    trace_index_entry_t at;
+    at.ordinal = ordinal;
+    at.offset = ownedOffset + static_cast<uint64_t>(pos - data);
+    for (size_t i = 0; i < TRACE_DELTA_STREAMS; ++i) {
+        at.prev[i] = prev[i];
+    }
+    return at;
+}
+
+void TraceReader::restore(const trace_index_entry_t& at)
+{
+    pos = data + at.offset;
+    for (size_t i = 0; i < TRACE_DELTA_STREAMS; ++i) {
+        prev[i] = at.prev[i];
+    }
+    ordinal = at.ordinal;
+    remaining = totalRecords - at.ordinal;
+    havePending = false;
+}
+
+bool TraceReader::seek(uint64_t start)
+{
+    uint64_t addr;
+    char rw;
+    if (mapLen == 0) {
+        havePending = false;
+        while (ordinal < start && decode(&addr, &rw)) {
+            ++ordinal;
+        }
+        return ordinal == start;
+    }
+
+    trace_index_entry_t at = trace_index_entry_t();
+    at.offset = firstOffset;
+
+    if (binary && encoding == TRACE_ENCODING_PACKED) {
+        at.ordinal = std::min(start, totalRecords);
+        at.offset += at.ordinal * TRACE_RECORD_SIZE;
+    } else {
+        std::vector<trace_index_entry_t> entries;
+        if (trace_read_index(tracePath + TRACE_INDEX_SUFFIX, size(), modTime,
+                    entries)) {
+            for (size_t i = 0; i < entries.size()
+                    && entries[i].ordinal <= start; ++i) {
+                at = entries[i];
+            }
+        }
+    }
+    restore(at);
+
+    // Decode forward to the exact access
+    while (ordinal < start && decode(&addr, &rw)) {
+        ++ordinal;
+    }
+    return ordinal == start;
+}
+
+TraceReader::~TraceReader()
+{
+    if (mapLen) {
+        munmap(const_cast<uint8_t *>(data), mapLen);
+    }
+    if (streamFd >= 0 && !tracePath.empty()) {
+        close(streamFd);
+    }
+}
+
+size_t TraceReader::read(uint64_t *addrs, uint8_t *writes, size_t max)
+{
+    size_t n = 0;
+
+    // Delta records stream straight into the batch arrays
+    if (binary && encoding == TRACE_ENCODING_DELTA) {
+        bool write;
+        do {
+            while (n < max && windowLeft && nextDelta(&addrs[n], &write)) {
+                writes[n++] = write ? TRUE : FALSE;
+                ++ordinal;
+                --windowLeft;
+            }
+        } while (n < max && windowLeft && refill());
+        return n;
+    }
+
+    uint64_t addr;
+    char rw;
+    while (n < max && next(&addr, &rw)) {
+        addrs[n] = addr;
+        writes[n] = (rw == WRITE) ? TRUE : FALSE;
+        ++n;
+    }
+    return n;
+}
+
+size_t TraceReader::readRuns(uint64_t *addrs, uint8_t *writes,
+        uint32_t *repeatReads, uint32_t *repeatWrites, size_t max,
+        uint64_t blockBits)
+{
+    size_t n = 0;
+    while (n < max) {
+        if (!havePending && !next(&pendingAddr, &pendingRw)) {
+            break;
+        }
+        havePending = false;
+
+        addrs[n] = pendingAddr;
+        writes[n] = (pendingRw == WRITE) ? TRUE : FALSE;
+        uint64_t block = pendingAddr >> blockBits;
+        uint32_t reads = 0;
+        uint32_t wr = 0;
+
+        // Extend the run until the block changes or a counter would wrap
+        while (next(&pendingAddr, &pendingRw)) {
+            if ((pendingAddr >> blockBits) != block
+                    || reads == UINT32_MAX || wr == UINT32_MAX) {
+                havePending = true;
+                break;
+            }
+            if (pendingRw == WRITE) {
+                ++wr;
+            } else {
+                ++reads;
+            }
+        }
+
+        repeatReads[n] = reads;
+        repeatWrites[n] = wr;
+        ++n;
+    }
+    return n;
+}
+
+TraceBuffer::TraceBuffer(TraceReader& reader)
+{
+    uint64_t addr;
+    char rw;
+    while (reader.next(&addr, &rw)) {
+        addrs.push_back(addr);
+        writes.push_back((rw == WRITE) ? TRUE : FALSE);
+    }
+}
+
+size_t TraceBuffer::fillRuns(size_t *cursor, uint64_t blockBits,
+        trace_batch_t *batch) const
+{
+    size_t i = *cursor;
+    size_t n = 0;
+    while (n < TRACE_BATCH_SIZE && i < addrs.size()) {
+        batch->addr[n] = addrs[i];
+        batch->write[n] = writes[i];
+        uint64_t block = addrs[i] >> blockBits;
+        uint32_t reads = 0;
+        uint32_t wr = 0;
+
+        // Extend the run until the block changes or a counter would wrap
+        for (++i; i < addrs.size() && (addrs[i] >> blockBits) == block
+                && reads < UINT32_MAX && wr < UINT32_MAX; ++i) {
+            if (writes[i]) {
+                ++wr;
+            } else {
+                ++reads;
+            }
+        }
+
+        batch->repeat_reads[n] = reads;
+        batch->repeat_writes[n] = wr;
+        ++n;
+    }
+    batch->n = n;
+    *cursor = i;
+    return n;
+}
@@ -0,0 +1,604 @@
+/**
+ * @file trace.hpp
+ * @brief Trace file formats and reader for the cache simulator
+ *
+ * Two on-disk trace formats are understood:
+ *
+ *  - text:   one "0x<hex address> <R|W>" access per line, as in traces/
+ *  - binary: a fixed header followed by records in one of two encodings
+ *      packed: 8-byte little-endian records
+ *      delta:  zigzag varint address deltas, see TraceDeltaEncoder
+ *
+ * In a binary record the R/W flag replaces bit 0 of the address. Bit 0 is
+ * part of the byte offset for any block size of 2 bytes or more, and the
+ * simulator only ever looks at block addresses, so no information the model
+ * uses is lost.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache.hpp"
+
+// Binary trace header layout (all integers little-endian):
+//   [0, 8)   magic "CSIMTRC\n"
+//   [8, 12)  format version
+//   [12, 16) record encoding
+//   [16, 24) number of records that follow
+static const char TRACE_MAGIC[8] = {'C', 'S', 'I', 'M', 'T', 'R', 'C', '\n'};
+static const uint32_t TRACE_VERSION = 1;
+static const size_t TRACE_HEADER_SIZE = 24;
+
+// Record encodings
+static const uint32_t TRACE_ENCODING_PACKED = 0;
+static const uint32_t TRACE_ENCODING_DELTA = 1;
+
+// Size of a packed record
+static const size_t TRACE_RECORD_SIZE = 8;
+
+// Longest delta record: 3 tag bits + 64 zigzag bits in 7-bit groups
+static const size_t TRACE_DELTA_MAX_SIZE = 10;
+
+// Number of independent delta streams, one per address region
+static const size_t TRACE_DELTA_STREAMS = 4;
+
+// Address bit that carries the R/W flag in a binary record (set for writes)
+static const uint64_t TRACE_RW_BIT = 1;
+
+/**
+ * @brief Store a 64-bit value as 8 little-endian bytes
+ */
+inline void trace_store_le64(uint8_t *dst, uint64_t val)
+{
+    for (int i = 0; i < 8; ++i) {
+        dst[i] = static_cast<uint8_t>(val >> (8 * i));
+    }
+}
+
+/**
+ * @brief Load a 64-bit value from 8 little-endian bytes
+ */
+inline uint64_t trace_load_le64(const uint8_t *src)
+{
+    uint64_t val = 0;
+    for (int i = 0; i < 8; ++i) {
+        val |= static_cast<uint64_t>(src[i]) << (8 * i);
+    }
+    return val;
+}
+
+/**
+ * @brief Fold an access into a binary trace record
+ */
+inline uint64_t trace_pack(uint64_t addr, char rw)
+{
+    return (addr & ~TRACE_RW_BIT) | (rw == WRITE ? TRACE_RW_BIT : 0);
+}
+
+/**
+ * @brief Split a binary trace record back into address and R/W flag
+ */
+inline void trace_unpack(uint64_t rec, uint64_t *addr, char *rw)
+{
+    *addr = rec & ~TRACE_RW_BIT;
+    *rw = (rec & TRACE_RW_BIT) ? WRITE : READ;
+}
+
+/**
+ * @brief Write a binary trace header announcing num_records records
+ * @return true on success
+ */
+bool trace_write_header(FILE *fout, uint32_t encoding, uint64_t num_records);
+
+// Chunk index sidecar (<trace>.idx) layout (all integers little-endian):
+//   [0, 8)   magic "CSIMIDX\n"
+//   [8, 16)  format version
+//   [16, 24) size in bytes of the trace file it indexes
+//   [24, 32) modification time of that file, in ns since the epoch
+//   [32, 40) number of entries that follow
+// followed by one trace_index_entry_t per entry, as 6 64-bit words each
+static const char TRACE_INDEX_MAGIC[8] = {'C', 'S', 'I', 'M', 'I', 'D', 'X', '\n'};
+static const uint32_t TRACE_INDEX_VERSION = 2;
+static const size_t TRACE_INDEX_HEADER_SIZE = 40;
+static const size_t TRACE_INDEX_ENTRY_SIZE = 48;
+static const char TRACE_INDEX_SUFFIX[] = ".idx";
+
+// Default number of accesses between index entries
+static const uint64_t TRACE_INDEX_INTERVAL = 16384;
+
+// Struct for a position in a trace that decoding can resume from
+struct trace_index_entry_t {
+    uint64_t ordinal;                       // accesses before this position
+    uint64_t offset;                        // byte offset into the trace file
+    uint64_t prev[TRACE_DELTA_STREAMS];     // delta decoder state, else 0
+};
+
+/**
+ * @brief Write a chunk index for a trace of trace_size bytes last modified
+ * at trace_mtime
+ * @return true on success
+ */
+bool trace_write_index(const std::string& path, uint64_t trace_size,
+        uint64_t trace_mtime, const std::vector<trace_index_entry_t>& entries);
+
+/**
+ * @brief Load a chunk index, ignoring it unless it matches both trace_size
+ * and trace_mtime
+ * @return true if entries were loaded
+ */
+bool trace_read_index(const std::string& path, uint64_t trace_size,
+        uint64_t trace_mtime, std::vector<trace_index_entry_t>& entries);
+
+// Text trace line decoders, see trace_text.cpp
+static const uint32_t TRACE_DECODER_SCALAR = 0;
+static const uint32_t TRACE_DECODER_SSE41 = 1;
+static const uint32_t TRACE_DECODER_AVX2 = 2;
+
+/**
+ * @brief Decode text lines with the given decoder from now on instead of
+ * the best one this CPU supports; call before any trace is read
+ * @return false, leaving the decoder unchanged, if this CPU or build does not
+ * support it
+ */
+bool trace_select_decoder(uint32_t decoder);
+
+/**
+ * @brief Region of the address space an address is delta-coded against
+ *
+ * Code and globals, the brk heap, the mmap area (shared libraries and large
+ * heap blocks) and the stack each get their own predecessor, so interleaved
+ * stack and heap accesses both stay within a byte or two of their previous
+ * address.
+ */
+inline unsigned trace_delta_stream(uint64_t addr)
+{
+    if (addr >= 0x7ff000000000UL) {
+        return 3; // stack, vsyscall
+    } else if (addr >= 0x7f0000000000UL) {
+        return 2; // mmap area
+    } else if (addr >= 0x1000000UL) {
+        return 1; // brk heap
+    }
+    return 0; // code and globals
+}
+
+/**
+ * @brief Encoder for the delta trace encoding
+ *
+ * Each access is stored as the difference between its address and the
+ * previous address of the same stream, halved since bit 0 is never part of
+ * the delta. The zigzagged difference is written as a little-endian base-128
+ * varint whose first byte also carries the R/W flag (bit 0) and the stream
+ * number (bits 1-2):
+ *
+ *   byte 0:  [more:1][zigzag bits 0-3:4][stream:2][write:1]
+ *   byte n:  [more:1][next 7 zigzag bits]
+ */
+class TraceDeltaEncoder
+{
+    private:
+        uint64_t prev[TRACE_DELTA_STREAMS];
+
+    public:
+        TraceDeltaEncoder()
+        {
+            for (size_t i = 0; i < TRACE_DELTA_STREAMS; ++i) {
+                prev[i] = 0;
+            }
+        }
+
+        /**
+         * @brief Encode one access
+         * @param out receives at most TRACE_DELTA_MAX_SIZE bytes
+         * @return number of bytes written to out
+         */
+        size_t encode(uint64_t addr, char rw, uint8_t *out)
+        {
+            unsigned stream = trace_delta_stream(addr);
+            uint64_t cur = addr & ~TRACE_RW_BIT;
+            uint64_t diff = cur - prev[stream];
+            prev[stream] = cur;
+
+            // Arithmetic halving, then zigzag so small negatives stay small
+            uint64_t half = (diff >> 1) | (diff & (1UL << 63));
+            uint64_t zigzag = (half << 1) ^ (0UL - (half >> 63));
+
+            uint64_t rest = zigzag >> 4;
+            out[0] = static_cast<uint8_t>((zigzag & 0xfUL) << 3 | stream << 1
+                    | (rw == WRITE ? 1U : 0U) | (rest ? 0x80U : 0U));
+            size_t len = 1;
+            while (rest) {
+                uint64_t more = rest >> 7;
+                out[len++] = static_cast<uint8_t>((rest & 0x7fUL)
+                        | (more ? 0x80U : 0U));
+                rest = more;
+            }
+            return len;
+        }
+}; // TraceDeltaEncoder
+
+/**
+ * @brief Sequential reader over a trace in either format
+ *
+ * Regular files are mapped read-only with mmap and decoded in place, so
+ * repeated runs over the same trace read straight out of the page cache.
+ * Anything that cannot be mapped (pipes, stdin) is streamed through a
+ * bounded buffer that is refilled as it drains, so a trace piped in from a
+ * decompressor never has to fit in memory. The format is detected from the
+ * first bytes of the data.
+ */
+class TraceReader
+{
+    private:
+        /**
+         * Trace bytes, the current decode position within them, where
+         * decoding has to stop and where the bytes end. The two ends only
+         * differ for a stream, whose last record may still be incomplete.
+         */
+        const uint8_t *data;
+        const uint8_t *pos;
+        const uint8_t *end;
+        const uint8_t *dataEnd;
+
+        /**
+         * Where the first record starts, and the trace path (empty when
+         * reading stdin)
+         */
+        size_t firstOffset;
+        std::string tracePath;
+
+        /**
+         * Length of the mapping if data is mmapped, 0 if data is streamed
+         */
+        size_t mapLen;
+
+        /**
+         * Stream buffer, the bytes of it in use and the offset of its first
+         * byte in the stream. streamFd is -1 once the stream is exhausted.
+         */
+        std::vector<uint8_t> owned;
+        size_t filled;
+        uint64_t ownedOffset;
+        int streamFd;
+
+        /**
+         * Modification time of the trace file in ns, 0 for stdin
+         */
+        uint64_t modTime;
+
+        bool binary;
+        uint32_t encoding;
+
+        /**
+         * Delta encoding state: records left and last address per stream.
+         * For a streamed packed trace, records not yet exposed by frame().
+         */
+        uint64_t totalRecords;
+        uint64_t remaining;
+        uint64_t prev[TRACE_DELTA_STREAMS];
+
+        /**
+         * Accesses delivered so far, and how many more may be delivered
+         */
+        uint64_t ordinal;
+        uint64_t windowLeft;
+
+        /**
+         * Access read ahead by readRuns() that starts the next run
+         */
+        bool havePending;
+        uint64_t pendingAddr;
+        char pendingRw;
+
+        bool nextText(uint64_t *addr, char *rw);
+
+        /**
+         * @brief Read more of a stream into the free end of its buffer
+         */
+        void fill();
+
+        /**
+         * @brief Move end to the last point of a stream buffer up to which
+         * records are known to be complete
+         */
+        void frame();
+
+        /**
+         * @brief Drop the decoded part of a stream buffer and read on until
+         * another record can be decoded or the stream ends
+         * @return false if there is nothing more to read
+         */
+        bool refill();
+
+        /**
+         * @brief Decode one delta record, inverse of TraceDeltaEncoder
+         */
+        bool nextDelta(uint64_t *addr, bool *write)
+        {
+            if (remaining == 0 || pos >= end) {
+                return false;
+            }
+
+            uint8_t byte = *pos++;
+            unsigned stream = (byte >> 1) & 3U;
+            *write = (byte & 1U) != 0;
+            uint64_t zigzag = (byte >> 3) & 0xfUL;
+            for (unsigned shift = 4; byte & 0x80U; shift += 7) {
+                if (pos == dataEnd || shift >= 64) { // truncated or corrupt
+                    remaining = 0;
+                    return false;
+                }
+                byte = *pos++;
+                zigzag |= static_cast<uint64_t>(byte & 0x7fU) << shift;
+            }
+
+            uint64_t half = (zigzag >> 1) ^ (0UL - (zigzag & 1UL));
+            prev[stream] += half << 1;
+            *addr = prev[stream];
+            --remaining;
+            return true;
+        }
+
+        /**
+         * @brief Decode the next access in the buffer
+         */
+        bool decodeBuffered(uint64_t *addr, char *rw)
+        {
+            if (!binary) {
+                return nextText(addr, rw);
+            }
+            if (encoding == TRACE_ENCODING_DELTA) {
+                bool write;
+                if (!nextDelta(addr, &write)) {
+                    return false;
+                }
+                *rw = write ? WRITE : READ;
+                return true;
+            }
+            if (end - pos < static_cast<ptrdiff_t>(TRACE_RECORD_SIZE)) {
+                return false;
+            }
+            trace_unpack(trace_load_le64(pos), addr, rw);
+            pos += TRACE_RECORD_SIZE;
+            return true;
+        }
+
+        /**
+         * @brief Decode the next access regardless of the window
+         */
+        bool decode(uint64_t *addr, char *rw)
+        {
+            while (!decodeBuffered(addr, rw)) {
+                if (!refill()) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Resume decoding from a position returned by mark()
+         */
+        void restore(const trace_index_entry_t& at);
+
+    public:
+        /**
+         * @brief Open a trace and detect its format
+         * @param path trace file to read, or NULL for stdin
+         *
+         * Exits with an error message if the file cannot be read, or if it
+         * starts like a binary trace but the header is truncated or of an
+         * unknown version.
+         */
+        explicit TraceReader(const char *path);
+        ~TraceReader();
+
+        TraceReader(const TraceReader&) = delete;
+        TraceReader& operator=(const TraceReader&) = delete;
+
+        /**
+         * @brief Decode up to max accesses into parallel arrays
+         * @param writes set to TRUE for writes and FALSE for reads
+         * @return number of accesses decoded, 0 once the trace is exhausted
+         */
+        size_t read(uint64_t *addrs, uint8_t *writes, size_t max);
+
+        /**
+         * @brief Decode up to max runs of accesses to the same block
+         *
+         * Each run is its first access (addrs, writes) plus the number of
+         * reads and writes that immediately follow it within the same
+         * 2^blockBits-byte block. Runs are never split across calls. Don't
+         * mix with read() or next() on the same reader.
+         *
+         * @return number of runs decoded, 0 once the trace is exhausted
+         */
+        size_t readRuns(uint64_t *addrs, uint8_t *writes,
+                uint32_t *repeatReads, uint32_t *repeatWrites, size_t max,
+                uint64_t blockBits);
+
+        /**
+         * @brief Read the next access from the trace
+         * @return false once the trace or the window set by limit() is
+         * exhausted
+         */
+        bool next(uint64_t *addr, char *rw)
+        {
+            if (windowLeft == 0 || !decode(addr, rw)) {
+                return false;
+            }
+            ++ordinal;
+            --windowLeft;
+            return true;
+        }
+
+        /**
+         * @brief Position the reader before access number start
+         *
+         * Packed binary traces are seeked directly. Other formats resume
+         * from the closest preceding entry of the <trace>.idx sidecar if
+         * one exists and matches the trace, and decode forward from there,
+         * or from the beginning of the trace without an index. A stream
+         * can only be decoded forward from where it is.
+         *
+         * @return false if the trace has fewer than start accesses, or if
+         * a stream is already past start
+         */
+        bool seek(uint64_t start);
+
+        /**
+         * @brief Stop after count more accesses have been read
+         */
+        void limit(uint64_t count)
+        {
+            windowLeft = count;
+        }
+
+        /**
+         * @brief Position of the next access, for building an index
+         */
+        trace_index_entry_t mark() const;
+
+        /**
+         * @brief Modification time of the trace file in ns since the epoch,
+         * 0 when reading stdin
+         */
+        uint64_t mtime() const
+        {
+            return modTime;
+        }
+
+        /**
+         * @brief Size in bytes of the whole trace file, or of as much of a
+         * stream as has been read
+         */
+        uint64_t size() const
+        {
+            return mapLen ? static_cast<uint64_t>(mapLen)
+                : ownedOffset + static_cast<uint64_t>(filled);
+        }
+
+        bool isBinary() const
+        {
+            return binary;
+        }
+}; // TraceReader
+
+// Runs per batch handed from the reader thread to the simulator
+static const size_t TRACE_BATCH_SIZE = 4096;
+
+// Batches in flight between reader and simulator; bounds pipeline memory
+static const size_t TRACE_RING_SLOTS = 8;
+
+// Struct for a batch of decoded runs of same-block accesses
+struct trace_batch_t {
+    size_t n;                                   // runs in this batch
+    uint64_t addr[TRACE_BATCH_SIZE];            // first access of each run
+    uint8_t write[TRACE_BATCH_SIZE];            // TRUE if it is a write
+    uint32_t repeat_reads[TRACE_BATCH_SIZE];    // reads to the same block after it
+    uint32_t repeat_writes[TRACE_BATCH_SIZE];   // writes to the same block after it
+};
+
+/**
+ * @brief Decodes a trace on a reader thread ahead of the simulator
+ *
+ * The reader thread fills batches and hands them to the consuming thread
+ * through a single-producer/single-consumer ring of TRACE_RING_SLOTS
+ * batches. Each side only ever writes its own index, so the hand-off is two
+ * atomic loads and one store per batch. The end of the trace is published
+ * as an empty batch.
+ */
+class TracePipeline
+{
+    private:
+        TraceReader& reader;
+        uint64_t blockBits;
+        std::vector<trace_batch_t> slots;
+
+        /**
+         * Batches published by the reader and consumed by the simulator.
+         * Kept on separate cache lines so the two threads don't false share.
+         */
+        alignas(64) std::atomic<size_t> head;
+        alignas(64) std::atomic<size_t> tail;
+        std::atomic<bool> stop;
+
+        std::thread worker;
+
+        void produce();
+
+    public:
+        /**
+         * @brief Start decoding reader on a new thread
+         * @param blockBits accesses are collapsed into runs per 2^blockBits
+         * byte block
+         */
+        TracePipeline(TraceReader& reader_i, uint64_t blockBits_i);
+
+        /**
+         * Stops and joins the reader thread, even if batches are unconsumed
+         */
+        ~TracePipeline();
+
+        TracePipeline(const TracePipeline&) = delete;
+        TracePipeline& operator=(const TracePipeline&) = delete;
+
+        /**
+         * @brief Wait for the next batch of accesses
+         * @return the batch, or NULL once the trace is exhausted
+         *
+         * The batch stays valid until release() is called.
+         */
+        const trace_batch_t *acquire();
+
+        /**
+         * @brief Hand the batch returned by acquire() back to the reader
+         */
+        void release();
+}; // TracePipeline
+
+/**
+ * @brief A trace decoded once into memory for repeated simulation
+ *
+ * Used when several configurations run against the same trace in one
+ * process, so the trace is parsed only once. Batches of runs are cut from
+ * it on demand for whatever block size a configuration uses. It is never
+ * modified after loading, so any number of threads may cut batches from it
+ * at once.
+ */
+class TraceBuffer
+{
+    private:
+        std::vector<uint64_t> addrs;
+        std::vector<uint8_t> writes;
+
+    public:
+        /**
+         * @brief Load every access the reader has left (within its window)
+         */
+        explicit TraceBuffer(TraceReader& reader);
+
+        size_t size() const
+        {
+            return addrs.size();
+        }
+
+        /**
+         * @brief Fill a batch with runs of same-block accesses
+         * @param cursor index of the first access to use, advanced past the
+         * accesses consumed
+         * @return number of runs in the batch, 0 at the end of the buffer
+         */
+        size_t fillRuns(size_t *cursor, uint64_t blockBits,
+                trace_batch_t *batch) const;
+}; // TraceBuffer
+
+#endif // TRACE_H
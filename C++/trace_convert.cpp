@@ -0,0 +1,93 @@
+/**
+ * @file trace_convert.cpp
+ * @brief Converts traces into the binary trace formats
+ *
+ * Usage: ./cachesim-convert [-d] <input.trace> <output.btrace>
+ *     -d     Use the delta encoding instead of packed 8-byte records
+ *
+ * The input may be in any format TraceReader understands. The header is
+ * written with a record count of zero first and patched once the whole input
+ * has been read, so the output must be a seekable file.
+ */
+
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include "trace.hpp"
+
+static void print_err_usage()
+{
+    std::cout << "./cachesim-convert [-d] <input.trace> <output.btrace>"
+              << std::endl;
+    std::cout << "    -d       Delta-encode records instead of packing them"
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *const argv[])
+{
+    int opt;
+    uint32_t encoding = TRACE_ENCODING_PACKED;
+
+    while (-1 != (opt = getopt(argc, argv, "dh"))) {
+        switch (opt) {
+            case 'd':
+                encoding = TRACE_ENCODING_DELTA;
+                break;
+            case 'h':
+            default:
+                print_err_usage();
+                break;
+        }
+    }
+    if (argc - optind != 2) {
+        print_err_usage();
+    }
+    const char *in_path = argv[optind];
+    const char *out_path = argv[optind + 1];
+
+    FILE *fout = fopen(out_path, "wb");
+    if (fout == NULL) {
+        std::cout << "Could not open " << out_path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    TraceReader reader(in_path);
+    if (!trace_write_header(fout, encoding, 0)) {
+        std::cout << "Write to " << out_path << " failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    TraceDeltaEncoder delta;
+    uint64_t count = 0;
+    uint64_t addr;
+    char rw;
+    uint8_t rec[TRACE_DELTA_MAX_SIZE];
+    while (reader.next(&addr, &rw)) {
+        size_t len;
+        if (encoding == TRACE_ENCODING_DELTA) {
+            len = delta.encode(addr, rw, rec);
+        } else {
+            trace_store_le64(rec, trace_pack(addr, rw));
+            len = TRACE_RECORD_SIZE;
+        }
+        if (fwrite(rec, 1, len, fout) != len) {
+            std::cout << "Write to " << out_path << " failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+        ++count;
+    }
+
+    // Patch the real record count into the header
+    if (fseek(fout, 0, SEEK_SET) != 0
+            || !trace_write_header(fout, encoding, count)) {
+        std::cout << "Could not finalize " << out_path << std::endl;
+        return EXIT_FAILURE;
+    }
+    fclose(fout);
+
+    std::cout << in_path << ": " << count << " records" << std::endl;
+    return 0;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file trace_index.cpp
+ * @brief Builds the chunk index sidecar for a trace
+ *
+ * Usage: ./cachesim-index [-n interval] <trace>...
+ *     -n N   Record a resume position every N accesses
+ *
+ * Writes <trace>.idx next to each trace. cachesim uses it to start a
+ * --start/--count window without decoding the trace from the beginning.
+ */
+
+#include <getopt.h>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "trace.hpp"
+
+static void print_err_usage()
+{
+    std::cout << "./cachesim-index [-n interval] <trace>..." << std::endl;
+    std::cout << "    -n N     Index entry every N accesses (default "
+              << TRACE_INDEX_INTERVAL << ")" << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *const argv[])
+{
+    int opt;
+    uint64_t interval = TRACE_INDEX_INTERVAL;
+
+    while (-1 != (opt = getopt(argc, argv, "n:h"))) {
+        switch (opt) {
+            case 'n':
+                interval = strtoull(optarg, NULL, 0);
+                break;
+            case 'h':
+            default:
+                print_err_usage();
+                break;
+        }
+    }
+    if (optind == argc || interval == 0) {
+        print_err_usage();
+    }
+
+    for (int i = optind; i < argc; ++i) {
+        TraceReader reader(argv[i]);
+        std::vector<trace_index_entry_t> entries;
+
+        uint64_t count = 0;
+        uint64_t addr;
+        char rw;
+        for (;;) {
+            if (count % interval == 0) {
+                entries.push_back(reader.mark());
+            }
+            if (!reader.next(&addr, &rw)) {
+                break;
+            }
+            ++count;
+        }
+
+        std::string indexPath = std::string(argv[i]) + TRACE_INDEX_SUFFIX;
+        if (!trace_write_index(indexPath, reader.size(), reader.mtime(),
+                    entries)) {
+            std::cout << "Could not write " << indexPath << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << indexPath << ": " << entries.size() << " entries over "
+                  << count << " accesses" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file trace_pipeline.cpp
+ * @brief Reader thread and batch ring feeding the simulator
+ */
+
+#include "trace.hpp"
+
+TracePipeline::TracePipeline(TraceReader& reader_i, uint64_t blockBits_i)
+    : reader(reader_i), blockBits(blockBits_i), slots(TRACE_RING_SLOTS),
+      head(0), tail(0), stop(false)
+{
+    worker = std::thread(&TracePipeline::produce, this);
+}
+
+TracePipeline::~TracePipeline()
+{
+    stop.store(true, std::memory_order_relaxed);
+    worker.join();
+}
+
+void TracePipeline::produce()
+{
+    size_t h = 0;
+    for (;;) {
+        // Wait for a free slot
+        while (h - tail.load(std::memory_order_acquire) == TRACE_RING_SLOTS) {
+            if (stop.load(std::memory_order_relaxed)) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+
+        trace_batch_t& batch = slots[h % TRACE_RING_SLOTS];
+        batch.n = reader.readRuns(batch.addr, batch.write,
+                batch.repeat_reads, batch.repeat_writes, TRACE_BATCH_SIZE,
+                blockBits);
+        head.store(++h, std::memory_order_release);
+
+        if (batch.n == 0) { // end of trace has been published
+            return;
+        }
+    }
+}
+
+const trace_batch_t *TracePipeline::acquire()
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    while (head.load(std::memory_order_acquire) == t) {
+        std::this_thread::yield();
+    }
+
+    const trace_batch_t& batch = slots[t % TRACE_RING_SLOTS];
+    return batch.n ? &batch : NULL;
+}
+
+void TracePipeline::release()
+{
+    tail.store(tail.load(std::memory_order_relaxed) + 1,
+            std::memory_order_release);
+}
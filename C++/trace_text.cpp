@@ -0,0 +1,314 @@
+/**
+ * @file trace_text.cpp
+ * @brief Text trace parser with SSE4.1 and AVX2 line decoders
+ *
+ * A text trace line is "0x" followed by 1 to 16 hex digits, blanks, the R/W
+ * flag and a newline. On x86 the common case is decoded with SIMD: the line
+ * is classified into digit / blank / newline bitmasks from one 32-byte
+ * window, and the digits are turned into an address with a shuffle and a
+ * multiply-add instead of a per-character loop. Which decoder runs is picked
+ * at startup from CPUID, and can be overridden with trace_select_decoder().
+ * Lines the SIMD decoders do not recognize, and every line on other hosts, go
+ * through the scalar table-driven parser.
+ */
+
+#include "trace.hpp"
+
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define TRACE_HAVE_SIMD 1
+#include <immintrin.h>
+#else
+#define TRACE_HAVE_SIMD 0
+#endif
+
+/**
+ * @brief Character class table for the scalar parser
+ *
+ * Hex digits map to their value, blanks to HEX_BLANK and everything else to
+ * HEX_OTHER, so the parser needs one load per character instead of a chain
+ * of range comparisons.
+ */
+static const uint8_t HEX_BLANK = 0x10;
+static const uint8_t HEX_OTHER = 0xff;
+
+struct HexTable
+{
+    uint8_t val[256];
+
+    HexTable()
+    {
+        memset(val, HEX_OTHER, sizeof(val));
+        for (int i = 0; i < 10; ++i) {
+            val['0' + i] = static_cast<uint8_t>(i);
+        }
+        for (int i = 0; i < 6; ++i) {
+            val['a' + i] = static_cast<uint8_t>(10 + i);
+            val['A' + i] = static_cast<uint8_t>(10 + i);
+        }
+        val[' '] = val['\t'] = val['\r'] = val['\n'] = HEX_BLANK;
+    }
+};
+
+static const HexTable HEX;
+
+#if TRACE_HAVE_SIMD
+
+/**
+ * Bytes a SIMD decoder may read starting at the beginning of a line
+ */
+static const ptrdiff_t SIMD_WINDOW = 32;
+
+/**
+ * @brief Shuffle controls that right-align the first n of 16 bytes
+ *
+ * Row n moves bytes [0, n) to positions [16 - n, 16) and zeroes the rest,
+ * so a number with fewer than 16 digits gets leading zero nibbles.
+ */
+struct AlignTable
+{
+    uint8_t ctl[17][16];
+
+    AlignTable()
+    {
+        for (int n = 0; n <= 16; ++n) {
+            for (int j = 0; j < 16; ++j) {
+                int src = j - (16 - n);
+                ctl[n][j] = src < 0 ? 0x80 : static_cast<uint8_t>(src);
+            }
+        }
+    }
+};
+
+static const AlignTable ALIGN;
+
+/**
+ * Per-line masks: bit i describes byte i of the 32-byte window
+ */
+struct LineMasks
+{
+    uint32_t hex;
+    uint32_t blank; // space or tab
+    uint32_t newline;
+};
+
+__attribute__((target("sse4.1")))
+static inline __m128i hex_mask_128(__m128i raw)
+{
+    __m128i lower = _mm_or_si128(raw, _mm_set1_epi8(0x20));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(raw, _mm_set1_epi8('0' - 1)),
+            _mm_cmplt_epi8(raw, _mm_set1_epi8('9' + 1)));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+            _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    return _mm_or_si128(digit, alpha);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i blank_mask_128(__m128i raw)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(raw, _mm_set1_epi8(' ')),
+            _mm_cmpeq_epi8(raw, _mm_set1_epi8('\t')));
+}
+
+/**
+ * @brief Convert n (1..16) ASCII hex digits into their value
+ */
+__attribute__((target("sse4.1")))
+static inline uint64_t hex_value_128(const uint8_t *digits, uint32_t n)
+{
+    __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(digits));
+
+    // Nibble values: '0'..'9' -> 0..9, 'a'..'f' / 'A'..'F' -> 10..15
+    __m128i lower = _mm_or_si128(raw, _mm_set1_epi8(0x20));
+    __m128i isAlpha = _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1));
+    __m128i nib = _mm_blendv_epi8(_mm_sub_epi8(raw, _mm_set1_epi8('0')),
+            _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)), isAlpha);
+
+    // Right-align the digits, then fold nibble pairs into bytes
+    nib = _mm_shuffle_epi8(nib, _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(ALIGN.ctl[n])));
+    __m128i bytes = _mm_maddubs_epi16(nib, _mm_set1_epi16(0x0110));
+    bytes = _mm_packus_epi16(bytes, bytes);
+
+    // Byte 0 now holds the most significant digits
+    uint64_t be;
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(&be), bytes);
+    return __builtin_bswap64(be);
+}
+
+/**
+ * @brief Finish decoding a line from its classification masks
+ * @return the start of the next line, or NULL if the line is not in the
+ * plain "0x<digits><blanks><flag>\n" shape
+ */
+__attribute__((target("sse4.1")))
+static inline const uint8_t *decode_line(const uint8_t *p, LineMasks m,
+        uint64_t *addr, char *rw)
+{
+    if (p[0] != '0' || (p[1] | 0x20) != 'x' || m.newline == 0) {
+        return NULL;
+    }
+
+    // Digits after "0x", then at least one blank, the flag and a newline
+    uint32_t n = static_cast<uint32_t>(__builtin_ctz(~(m.hex >> 2)));
+    uint32_t nl = static_cast<uint32_t>(__builtin_ctz(m.newline));
+    if (n == 0 || n > 16 || nl < 2 + n + 2) {
+        return NULL;
+    }
+
+    uint32_t flag = nl - 1;
+    uint32_t gap = flag - (2 + n);
+    uint32_t want = ((1U << gap) - 1U) << (2 + n);
+    if ((m.blank & want) != want || (m.blank >> flag & 1U) != 0
+            || p[flag] == '\r') {
+        return NULL;
+    }
+
+    *addr = hex_value_128(p + 2, n);
+    *rw = static_cast<char>(p[flag]);
+    return p + nl + 1;
+}
+
+__attribute__((target("sse4.1")))
+static const uint8_t *decode_line_sse4(const uint8_t *p, uint64_t *addr,
+        char *rw)
+{
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16));
+    __m128i nlv = _mm_set1_epi8('\n');
+
+    LineMasks m;
+    m.hex = static_cast<uint32_t>(_mm_movemask_epi8(hex_mask_128(lo)))
+        | static_cast<uint32_t>(_mm_movemask_epi8(hex_mask_128(hi))) << 16;
+    m.blank = static_cast<uint32_t>(_mm_movemask_epi8(blank_mask_128(lo)))
+        | static_cast<uint32_t>(_mm_movemask_epi8(blank_mask_128(hi))) << 16;
+    m.newline = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(lo, nlv)))
+        | static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(hi, nlv))) << 16;
+    return decode_line(p, m, addr, rw);
+}
+
+__attribute__((target("avx2")))
+static const uint8_t *decode_line_avx2(const uint8_t *p, uint64_t *addr,
+        char *rw)
+{
+    __m256i raw = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i lower = _mm256_or_si256(raw, _mm256_set1_epi8(0x20));
+    __m256i digit = _mm256_and_si256(
+            _mm256_cmpgt_epi8(raw, _mm256_set1_epi8('0' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), raw));
+    __m256i alpha = _mm256_and_si256(
+            _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+    __m256i blank = _mm256_or_si256(
+            _mm256_cmpeq_epi8(raw, _mm256_set1_epi8(' ')),
+            _mm256_cmpeq_epi8(raw, _mm256_set1_epi8('\t')));
+
+    LineMasks m;
+    m.hex = static_cast<uint32_t>(_mm256_movemask_epi8(
+                _mm256_or_si256(digit, alpha)));
+    m.blank = static_cast<uint32_t>(_mm256_movemask_epi8(blank));
+    m.newline = static_cast<uint32_t>(_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(raw, _mm256_set1_epi8('\n'))));
+    return decode_line(p, m, addr, rw);
+}
+
+typedef const uint8_t *(*LineDecoder)(const uint8_t *, uint64_t *, char *);
+
+static LineDecoder pick_line_decoder()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return decode_line_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return decode_line_sse4;
+    }
+    return NULL;
+}
+
+static LineDecoder fastDecoder = pick_line_decoder();
+
+#endif // TRACE_HAVE_SIMD
+
+bool trace_select_decoder(uint32_t decoder)
+{
+    if (decoder == TRACE_DECODER_SCALAR) {
+#if TRACE_HAVE_SIMD
+        fastDecoder = NULL;
+#endif
+        return true;
+    }
+#if TRACE_HAVE_SIMD
+    __builtin_cpu_init();
+    if (decoder == TRACE_DECODER_SSE41 && __builtin_cpu_supports("sse4.1")) {
+        fastDecoder = decode_line_sse4;
+        return true;
+    }
+    if (decoder == TRACE_DECODER_AVX2 && __builtin_cpu_supports("avx2")) {
+        fastDecoder = decode_line_avx2;
+        return true;
+    }
+#endif
+    return false;
+}
+
+/**
+ * Parse one "0x<hex>  <R|W>" line. Lines without any address digits are
+ * skipped, matching what the old fscanf loop accepted.
+ */
+bool TraceReader::nextText(uint64_t *addr, char *rw)
+{
+    for (;;) {
+#if TRACE_HAVE_SIMD
+        if (fastDecoder && end - pos >= SIMD_WINDOW) {
+            const uint8_t *nextLine = fastDecoder(pos, addr, rw);
+            if (nextLine) {
+                pos = nextLine;
+                return true;
+            }
+        }
+#endif
+
+        while (pos < end && HEX.val[*pos] == HEX_BLANK) {
+            ++pos;
+        }
+        if (pos == end) {
+            return false;
+        }
+
+        if (end - pos >= 2 && pos[0] == '0' && (pos[1] | 0x20) == 'x') {
+            pos += 2;
+        }
+
+        const uint8_t *digits = pos;
+        uint64_t val = 0;
+        uint8_t d;
+        while (pos < end && (d = HEX.val[*pos]) < 16) {
+            val = (val << 4) | d;
+            ++pos;
+        }
+        bool haveAddr = pos != digits;
+
+        while (pos < end && (*pos == ' ' || *pos == '\t')) {
+            ++pos;
+        }
+        bool haveRw = pos < end && HEX.val[*pos] != HEX_BLANK;
+        char flag = haveRw ? static_cast<char>(*pos) : 0;
+
+        // Skip to the start of the next line, which normally follows the
+        // R/W flag directly
+        if (haveRw && end - pos >= 2 && pos[1] == '\n') {
+            pos += 2;
+        } else {
+            const void *nl = memchr(pos, '\n', static_cast<size_t>(end - pos));
+            pos = nl ? static_cast<const uint8_t *>(nl) + 1 : end;
+        }
+
+        if (haveAddr && haveRw) {
+            *addr = val;
+            *rw = flag;
+            return true;
+        }
+    }
+}